@@ -1,4 +1,4 @@
-QT += core widgets
+QT += core widgets network
 QT += opengl
 
 TARGET = 277
@@ -0,0 +1,80 @@
+#include <scene/geometry/sphere.h>
+#include <scene/geometry/cube.h>
+#include <scene/geometry/square.h>
+#include <scene/geometry/disc.h>
+#include <scene/geometry/ring.h>
+#include <scene/materials/material.h>
+#include <QElapsedTimer>
+#include <random>
+#include <vector>
+#include <cstdio>
+
+//Times the intersect-only kernel of each analytic shape against the full intersection (kernel plus shading)
+//over the same rays, aimed so that about half of them hit.
+//  shapebench [rays per shape]
+
+static std::vector<Ray> MakeRays(unsigned int count)
+{
+    std::mt19937 generator(277);
+    std::uniform_real_distribution<float> uniform(-1.5f, 1.5f);
+    std::vector<Ray> rays;
+    rays.reserve(count);
+    for(unsigned int i = 0; i < count; i++)
+    {
+        glm::vec3 origin(uniform(generator), uniform(generator), 5.0f);
+        glm::vec3 target(uniform(generator), uniform(generator), 0.0f);
+        rays.push_back(Ray(origin, glm::normalize(target - origin)));
+    }
+    return rays;
+}
+
+//Results are summed into this so the calls can't be optimized away
+static volatile float sink;
+
+//Nanoseconds per ray of f over every ray, best of a few runs so a stray context switch doesn't count
+template<typename F>
+static double Time(const std::vector<Ray> &rays, F f)
+{
+    double best = 0;
+    for(int run = 0; run < 5; run++)
+    {
+        float sum = 0;
+        QElapsedTimer timer;
+        timer.start();
+        for(const Ray &r : rays)
+            sum += f(r);
+        double ns = double(timer.nsecsElapsed()) / rays.size();
+        if(run == 0 || ns < best)
+            best = ns;
+        sink = sum;
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int count = argc > 1 ? unsigned(atoi(argv[1])) : 1000000;
+    std::vector<Ray> rays = MakeRays(count);
+
+    Material material(glm::vec3(1));
+    Geometry* shapes[] = {new Sphere(), new Cube(), new SquarePlane(), new Disc(), new Ring()};
+    const char* names[] = {"sphere", "cube", "square", "disc", "ring"};
+
+    printf("%-8s %12s %12s %8s %6s\n", "shape", "t-only ns", "full ns", "ratio", "hits");
+    for(int i = 0; i < 5; i++)
+    {
+        Geometry* g = shapes[i];
+        g->material = &material;
+        //Not an identity, so both paths pay for taking the ray to object space
+        g->transform = Transform(glm::vec3(0.1f, -0.2f, 0), glm::vec3(20, 30, 0), glm::vec3(1.5f, 1.5f, 1.5f));
+
+        unsigned int hits = 0;
+        for(const Ray &r : rays)
+            hits += g->GetIntersectionT(r).t > 0;
+        double t_only = Time(rays, [g](const Ray &r){return g->GetIntersectionT(r).t;});
+        double full = Time(rays, [g](const Ray &r){return g->GetIntersection(r).t;});
+        printf("%-8s %12.1f %12.1f %8.2f %5.1f%%\n", names[i], t_only, full, full / t_only, 100.0 * hits / count);
+        delete g;
+    }
+    return 0;
+}
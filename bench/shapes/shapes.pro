@@ -0,0 +1,25 @@
+#Microbenchmark for the shapes' intersect-only kernels. Build it on its own:
+#  qmake bench/shapes/shapes.pro && make && ./shapebench
+QT += core widgets network opengl
+
+TARGET = shapebench
+TEMPLATE = app
+CONFIG += c++11 console release
+CONFIG -= app_bundle
+
+INCLUDEPATH += $$PWD/../../include
+
+include(../../src/src.pri)
+
+#The benchmark has its own main and no window
+SOURCES -= \
+    $$clean_path($$PWD/../../src/main.cpp) \
+    $$clean_path($$PWD/../../src/mainwindow.cpp) \
+    $$clean_path($$PWD/../../src/mygl.cpp) \
+    $$clean_path($$PWD/../../src/cameracontrolshelp.cpp)
+HEADERS -= \
+    $$clean_path($$PWD/../../src/mainwindow.h) \
+    $$clean_path($$PWD/../../src/mygl.h) \
+    $$clean_path($$PWD/../../src/cameracontrolshelp.h)
+
+SOURCES += $$PWD/main.cpp
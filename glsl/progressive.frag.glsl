@@ -1,8 +1,9 @@
 #version 150
-uniform sampler2D tex; //this is the texture
+uniform sampler2D tex; //the film's linear radiance, as floats
 in vec2 fragTexCoord; //this is the texture coord
 out vec4 finalColor; //this is the output color of the pixel
 
 void main() {
-    finalColor = texture(tex, fragTexCoord);
+    // Same mapping as Film::WriteBMP, so the window shows what gets saved
+    finalColor = vec4(clamp(texture(tex, fragTexCoord).rgb, 0.0, 1.0), 1.0);
 }
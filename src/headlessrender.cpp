@@ -0,0 +1,561 @@
+#include <headlessrender.h>
+#include <renderthread.h>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <iostream>
+#include <cstring>
+
+namespace
+{
+template<class T> void Put(QByteArray &b, const T &v)
+{
+    b.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+//Reads values back in the order they were Put, failing once the message runs out
+class MessageReader
+{
+public:
+    MessageReader(const QByteArray &b) : bytes(b), position(0){}
+    bool GetBytes(void *out, int count)
+    {
+        if(count < 0 || position + count > bytes.size())
+            return false;
+        std::memcpy(out, bytes.constData() + position, count);
+        position += count;
+        return true;
+    }
+    template<class T> bool Get(T &v) {return GetBytes(&v, sizeof(T));}
+    bool Skip(qint64 count)
+    {
+        if(count < 0 || position + count > bytes.size())
+            return false;
+        position += int(count);
+        return true;
+    }
+    bool AtEnd() const {return position == bytes.size();}
+
+private:
+    const QByteArray &bytes;
+    int position;
+};
+
+QByteArray Frame(const QByteArray &payload)
+{
+    QByteArray frame;
+    Put(frame, quint32(payload.size()));
+    frame.append(payload);
+    return frame;
+}
+
+//Moves the first whole message out of buffer, if there is one
+bool TakeMessage(QByteArray &buffer, QByteArray &message)
+{
+    quint32 size;
+    if(buffer.size() < int(sizeof(size)))
+        return false;
+    std::memcpy(&size, buffer.constData(), sizeof(size));
+    if(buffer.size() < int(sizeof(size) + size))
+        return false;
+    message = buffer.mid(sizeof(size), size);
+    buffer.remove(0, sizeof(size) + size);
+    return true;
+}
+
+//Blocks until every byte written to socket has gone out
+bool Send(QLocalSocket &socket, const QByteArray &payload)
+{
+    socket.write(Frame(payload));
+    while(socket.bytesToWrite() > 0)
+    {
+        if(!socket.waitForBytesWritten(-1))
+            return false;
+    }
+    return true;
+}
+}
+
+RenderJob::RenderJob() : integrator(NULL)
+{
+    intersection_engine.root = NULL;
+}
+
+RenderJob::~RenderJob()
+{
+    scene.Clear();
+    delete integrator;
+    BVHNode::releaseTree(intersection_engine.root);
+}
+
+bool RenderJob::Load(const QString &scene_path)
+{
+    QFile file(scene_path);
+    if(!file.exists())
+    {
+        std::cout << "Could not find the scene " << scene_path.toStdString() << std::endl;
+        return false;
+    }
+    //Paths in the scene file are relative to its folder
+    int i = scene_path.lastIndexOf(QChar('/'));
+    QStringRef local_path = scene_path.leftRef(i + 1);
+    xml_reader.LoadSceneFromFile(file, local_path, scene, integrator);
+    if(integrator == NULL)
+        return false;
+    integrator->scene = &scene;
+    integrator->intersection_engine = &intersection_engine;
+    intersection_engine.scene = &scene;
+    intersection_engine.root = BVHNode::buildBVHTree(scene.objects);
+    return true;
+}
+
+RenderCoordinator::RenderCoordinator(Scene &scene, const QString &server_name)
+    : worker_count(QThread::idealThreadCount()), max_restarts(16), tile_size(32), lease_timeout(0),
+      scene(scene), server_name(server_name), restarts(0), remaining(0), next_merge(0)
+{}
+
+RenderCoordinator::~RenderCoordinator()
+{
+    for(Connection &c : connections)
+        delete c.socket;
+    for(QProcess* p : processes)
+    {
+        if(p->state() != QProcess::NotRunning)
+        {
+            p->kill();
+            p->waitForFinished(1000);
+        }
+        delete p;
+    }
+}
+
+void RenderCoordinator::BuildLeases()
+{
+    unsigned int samples = scene.sqrt_samples * scene.sqrt_samples;
+    unsigned int range = scene.pass_samples > 0 ? scene.pass_samples : samples;
+    int width = scene.film.width, height = scene.film.height;
+    leases.clear();
+    //Range by range, so the whole image gets its first samples before any tile gets its last
+    for(unsigned int start = 0; start < samples; start += range)
+    {
+        for(int y = 0; y < height; y += tile_size)
+        {
+            for(int x = 0; x < width; x += tile_size)
+            {
+                TileLease l = {x, y, glm::min(x + tile_size, width), glm::min(y + tile_size, height),
+                               start, glm::min(start + range, samples)};
+                leases.push_back(l);
+            }
+        }
+    }
+    pending.clear();
+    for(unsigned int i = 0; i < leases.size(); i++)
+        pending.enqueue(i);
+    results.assign(leases.size(), QByteArray());
+    done.assign(leases.size(), false);
+    remaining = leases.size();
+    next_merge = 0;
+}
+
+void RenderCoordinator::StartWorkers()
+{
+    for(unsigned int i = 0; i < worker_count; i++)
+    {
+        QProcess* p = new QProcess();
+        p->setProcessChannelMode(QProcess::ForwardedChannels);
+        p->start(worker_program, worker_arguments);
+        processes.append(p);
+    }
+}
+
+bool RenderCoordinator::Run()
+{
+    if(tile_size <= 0)
+        tile_size = 32;
+    scene.film.ClearAccumulation();
+    BuildLeases();
+
+    //A server left behind by a coordinator that crashed would stop this one from listening
+    QLocalServer::removeServer(server_name);
+    if(!server.listen(server_name))
+    {
+        std::cout << "Could not listen on " << server_name.toStdString() << std::endl;
+        return false;
+    }
+    StartWorkers();
+
+    while(remaining > 0)
+    {
+        server.waitForNewConnection(connections.isEmpty() ? 100 : 0);
+        while(server.hasPendingConnections())
+        {
+            Connection c;
+            c.socket = server.nextPendingConnection();
+            c.lease = -1;
+            connections.append(c);
+        }
+
+        for(int i = 0; i < connections.size();)
+        {
+            if(ServiceConnection(connections[i]))
+            {
+                i++;
+                continue;
+            }
+            //Whatever the worker had is handed out again
+            if(connections[i].lease >= 0 && !done[connections[i].lease])
+                pending.prepend(connections[i].lease);
+            delete connections[i].socket;
+            connections.removeAt(i);
+        }
+
+        //Workers that crashed or were killed are started again, up to a limit in case they can never run
+        bool any_running = false;
+        for(QProcess* p : processes)
+        {
+            if(p->state() == QProcess::NotRunning && remaining > 0 && restarts < max_restarts)
+            {
+                std::cout << "Restarting a worker" << std::endl;
+                p->start(worker_program, worker_arguments);
+                restarts++;
+            }
+            any_running |= p->state() != QProcess::NotRunning;
+        }
+        if(!any_running && connections.isEmpty() && worker_count > 0 && restarts >= max_restarts)
+        {
+            std::cout << "Every worker has stopped, with " << remaining << " leases left" << std::endl;
+            return false;
+        }
+    }
+
+    QByteArray message;
+    Put(message, quint32(MESSAGE_DONE));
+    for(Connection &c : connections)
+        Send(*c.socket, message);
+    for(QProcess* p : processes)
+        p->waitForFinished(5000);
+
+    scene.film.ResolveTiles();
+    //Each camera sample traced one light path, so the splats are averaged over the samples per pixel
+    scene.film.MergeSplats(1.0f / glm::max(scene.sqrt_samples * scene.sqrt_samples, 1u));
+    return true;
+}
+
+bool RenderCoordinator::ServiceConnection(Connection &c)
+{
+    //Short waits, since every worker is checked in turn
+    c.socket->waitForReadyRead(connections.size() > 1 ? 1 : 10);
+    c.buffer.append(c.socket->readAll());
+    QByteArray message;
+    while(TakeMessage(c.buffer, message))
+    {
+        if(!StoreResult(message) && c.lease >= 0 && !done[c.lease])
+        {
+            std::cout << "Got a bad result, leasing it again" << std::endl;
+            pending.prepend(c.lease);
+        }
+        c.lease = -1;
+    }
+    if(c.socket->state() != QLocalSocket::ConnectedState)
+        return false;
+
+    if(c.lease >= 0 && lease_timeout > 0 && c.leased.elapsed() > lease_timeout && !done[c.lease])
+    {
+        //Offered to the next idle worker as well; whichever answers first is kept
+        pending.enqueue(c.lease);
+        c.leased.restart();
+    }
+    if(c.lease < 0)
+    {
+        while(!pending.isEmpty() && done[pending.head()])
+            pending.dequeue();
+        if(!pending.isEmpty())
+            SendLease(c, pending.dequeue());
+    }
+    return true;
+}
+
+void RenderCoordinator::SendLease(Connection &c, int lease)
+{
+    QByteArray message;
+    Put(message, quint32(MESSAGE_LEASE));
+    Put(message, qint32(lease));
+    Put(message, leases[lease]);
+    c.lease = lease;
+    c.leased.start();
+    if(!Send(*c.socket, message))
+        c.socket->abort();
+}
+
+bool RenderCoordinator::StoreResult(const QByteArray &message)
+{
+    MessageReader reader(message);
+    quint32 type;
+    qint32 lease;
+    if(!reader.Get(type) || type != MESSAGE_RESULT || !reader.Get(lease) || lease < 0 || lease >= int(leases.size()))
+        return false;
+    //A lease offered to two workers is kept from whichever answered first
+    if(done[lease])
+        return true;
+    if(!ValidResult(lease, message))
+        return false;
+    done[lease] = true;
+    results[lease] = message;
+    remaining--;
+
+    //Merged strictly in lease order, so floating point sums come out the same on every run
+    while(next_merge < leases.size() && done[next_merge])
+    {
+        MergeResult(next_merge, results[next_merge]);
+        results[next_merge] = QByteArray();
+        next_merge++;
+    }
+    return true;
+}
+
+bool RenderCoordinator::ValidResult(int lease, const QByteArray &message) const
+{
+    //The worker's tile is the lease and the border its filter reached into, clipped to the film
+    const TileLease &l = leases[lease];
+    const Film &film = scene.film;
+    int border = scene.filter != NULL ? int(glm::ceil(scene.filter->Radius())) : 0;
+    int x0 = glm::max(l.x0 - border, 0), x1 = glm::min(l.x1 + border, int(film.width));
+    int y0 = glm::max(l.y0 - border, 0), y1 = glm::min(l.y1 + border, int(film.height));
+
+    MessageReader reader(message);
+    quint32 type;
+    qint32 id;
+    int tile_x0, tile_y0, tile_x1, tile_y1;
+    if(!reader.Get(type) || !reader.Get(id) || !reader.Get(tile_x0) || !reader.Get(tile_y0) || !reader.Get(tile_x1) || !reader.Get(tile_y1)
+            || tile_x0 != x0 || tile_y0 != y0 || tile_x1 != x1 || tile_y1 != y1
+            || !reader.Skip(qint64(x1 - x0) * (y1 - y0) * sizeof(glm::vec4)))
+        return false;
+
+    quint32 has_aovs;
+    if(!reader.Get(has_aovs) || (has_aovs && !reader.Skip(qint64(l.x1 - l.x0) * (l.y1 - l.y0) * sizeof(AOVSample))))
+        return false;
+
+    quint32 splat_count;
+    if(!reader.Get(splat_count))
+        return false;
+    for(quint32 i = 0; i < splat_count; i++)
+    {
+        quint32 index;
+        if(!reader.Get(index) || index >= film.width * film.height || !reader.Skip(sizeof(glm::vec3)))
+            return false;
+    }
+    return reader.AtEnd();
+}
+
+void RenderCoordinator::MergeResult(int lease, const QByteArray &message)
+{
+    const TileLease &l = leases[lease];
+    Film &film = scene.film;
+    MessageReader reader(message);
+    quint32 type;
+    qint32 id;
+    FilmTile tile;
+    reader.Get(type);
+    reader.Get(id);
+    reader.Get(tile.x0);
+    reader.Get(tile.y0);
+    reader.Get(tile.x1);
+    reader.Get(tile.y1);
+    tile.sums.resize(glm::max(0, tile.x1 - tile.x0) * glm::max(0, tile.y1 - tile.y0));
+    reader.GetBytes(tile.sums.data(), tile.sums.size() * sizeof(glm::vec4));
+    film.MergeTile(tile);
+
+    unsigned int n = l.sample_end - l.sample_start;
+    quint32 has_aovs;
+    reader.Get(has_aovs);
+    for(int y = l.y0; y < l.y1; y++)
+    {
+        for(int x = l.x0; x < l.x1; x++)
+        {
+            unsigned int &count = film.SampleCount(x, y);
+            AOVSample aov;
+            if(has_aovs && reader.Get(aov) && film.AOVsEnabled())
+            {
+                if(count > 0)
+                    film.AOV(x, y).Merge(aov, count, n);
+                else
+                    film.AOV(x, y) = aov;
+            }
+            count += n;
+        }
+    }
+
+    quint32 splat_count;
+    reader.Get(splat_count);
+    for(quint32 i = 0; i < splat_count; i++)
+    {
+        quint32 index;
+        glm::vec3 color;
+        if(!reader.Get(index) || !reader.Get(color))
+            break;
+        film.AddSplat(glm::vec2(index % film.width + 0.5f, index / film.width + 0.5f), color);
+    }
+}
+
+RenderWorker::RenderWorker(Scene &scene, Integrator* integrator, const QString &server_name)
+    : scene(scene), integrator(integrator), server_name(server_name)
+{}
+
+int RenderWorker::Run()
+{
+    QLocalSocket socket;
+    socket.connectToServer(server_name);
+    if(!socket.waitForConnected(10000))
+    {
+        std::cout << "Could not connect to " << server_name.toStdString() << std::endl;
+        return 1;
+    }
+
+    QByteArray buffer, message;
+    while(true)
+    {
+        if(!TakeMessage(buffer, message))
+        {
+            if(!socket.waitForReadyRead(-1) && socket.state() != QLocalSocket::ConnectedState)
+                return 0;//The coordinator went away; there's nobody to send work to
+            buffer.append(socket.readAll());
+            continue;
+        }
+        MessageReader reader(message);
+        quint32 type;
+        if(!reader.Get(type) || type == MESSAGE_DONE)
+            return 0;
+        qint32 id;
+        TileLease lease;
+        if(type != MESSAGE_LEASE || !reader.Get(id) || !reader.Get(lease)
+                || lease.x0 < 0 || lease.y0 < 0 || lease.x1 > int(scene.film.width) || lease.y1 > int(scene.film.height))
+        {
+            std::cout << "Got a bad lease" << std::endl;
+            return 1;
+        }
+        if(!Send(socket, Render(id, lease)))
+            return 0;
+    }
+}
+
+QByteArray RenderWorker::Render(int id, const TileLease &lease)
+{
+    //The tile and the border its filter reaches into
+    Film &film = scene.film;
+    int border = scene.filter != NULL ? int(glm::ceil(scene.filter->Radius())) : 0;
+    int x0 = glm::max(lease.x0 - border, 0), x1 = glm::min(lease.x1 + border, int(film.width));
+    int y0 = glm::max(lease.y0 - border, 0), y1 = glm::min(lease.y1 + border, int(film.height));
+
+    //Each lease starts from empty sums and splats, so the result holds only its own samples.
+    //Only the area this lease writes and the pixels the last one splatted need clearing.
+    film.ClearTiles(x0, y0, x1, y1);
+    film.ClearSplats();
+    for(int y = lease.y0; y < lease.y1; y++)
+    {
+        for(int x = lease.x0; x < lease.x1; x++)
+        {
+            //Progressive integrators shrink their radius by sample index, so a lease picks up where the ranges before it left off
+            film.SampleCount(x, y) = lease.sample_start;
+            if(film.AOVsEnabled())
+                film.AOV(x, y) = AOVSample();
+        }
+    }
+
+    RenderThread thread(lease.x0, lease.x1, lease.y0, lease.y1, lease.sample_end, integrator->getMaxDepth(),
+                        &film, &scene.camera, integrator, NULL, scene.filter);
+    thread.start();
+    thread.wait();
+
+    QByteArray message;
+    Put(message, quint32(MESSAGE_RESULT));
+    Put(message, qint32(id));
+    Put(message, x0);
+    Put(message, y0);
+    Put(message, x1);
+    Put(message, y1);
+    for(int y = y0; y < y1; y++)
+        for(int x = x0; x < x1; x++)
+            Put(message, film.Accumulated(x, y));
+
+    Put(message, quint32(film.AOVsEnabled()));
+    if(film.AOVsEnabled())
+    {
+        for(int y = lease.y0; y < lease.y1; y++)
+            for(int x = lease.x0; x < lease.x1; x++)
+                Put(message, film.AOV(x, y));
+    }
+
+    //Light paths can splat anywhere in the image, so only the pixels they reached are sent
+    std::vector<unsigned int> splat_pixels;
+    std::vector<glm::vec3> splat_colors;
+    film.GetSplats(splat_pixels, splat_colors);
+    Put(message, quint32(splat_pixels.size()));
+    for(unsigned int i = 0; i < splat_pixels.size(); i++)
+    {
+        Put(message, quint32(splat_pixels[i]));
+        Put(message, splat_colors[i]);
+    }
+    return message;
+}
+
+bool IsHeadless(int argc, char *argv[])
+{
+    for(int i = 1; i < argc; i++)
+    {
+        if(std::strcmp(argv[i], "--coordinator") == 0 || std::strcmp(argv[i], "--worker") == 0)
+            return true;
+    }
+    return false;
+}
+
+int HeadlessMain(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless distributed renderer");
+    parser.addHelpOption();
+    parser.addPositionalArgument("scene", "Scene file to render");
+    parser.addPositionalArgument("image", "Output image, for the coordinator");
+    QCommandLineOption coordinator_option("coordinator", "Lease the render out to worker processes");
+    QCommandLineOption worker_option("worker", "Render leases from a coordinator");
+    QCommandLineOption workers_option("workers", "Worker processes to start", "count", QString::number(QThread::idealThreadCount()));
+    QCommandLineOption tile_option("tile", "Tile width and height in pixels", "size", "32");
+    QCommandLineOption timeout_option("lease-timeout", "Seconds before a lease is offered to another worker, 0 for never", "seconds", "0");
+    QCommandLineOption server_option("server", "Local socket name", "name", "277render");
+    parser.addOption(coordinator_option);
+    parser.addOption(worker_option);
+    parser.addOption(workers_option);
+    parser.addOption(tile_option);
+    parser.addOption(timeout_option);
+    parser.addOption(server_option);
+    parser.process(app);
+
+    QStringList positional = parser.positionalArguments();
+    if(positional.isEmpty() || (parser.isSet(coordinator_option) && positional.size() < 2))
+        parser.showHelp(1);
+    QString scene_path = positional[0];
+    QString server_name = parser.value(server_option);
+
+    RenderJob job;
+    if(!job.Load(scene_path))
+        return 1;
+
+    if(parser.isSet(worker_option))
+    {
+        RenderWorker worker(job.scene, job.integrator, server_name);
+        return worker.Run();
+    }
+
+    RenderCoordinator coordinator(job.scene, server_name);
+    coordinator.worker_count = parser.value(workers_option).toInt();
+    coordinator.tile_size = parser.value(tile_option).toInt();
+    coordinator.lease_timeout = int(parser.value(timeout_option).toFloat() * 1000);
+    coordinator.worker_program = QCoreApplication::applicationFilePath();
+    coordinator.worker_arguments << "--worker" << scene_path << "--server" << server_name;
+    if(!coordinator.Run())
+        return 1;
+    if(job.scene.denoiser != NULL)
+        job.scene.denoiser->Run(job.scene.film);
+    job.scene.film.WriteImage(positional[1]);
+    return 0;
+}
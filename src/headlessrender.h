@@ -0,0 +1,118 @@
+#pragma once
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QProcess>
+#include <QStringList>
+#include <QQueue>
+#include <QElapsedTimer>
+#include <scene/scene.h>
+#include <scene/xmlreader.h>
+#include <raytracing/integrator.h>
+#include <raytracing/intersectionengine.h>
+
+//Rendering without the GUI, split across worker processes on one machine.
+//  277 --coordinator <scene.xml> <image> [--workers N] [--tile S] [--lease-timeout SECONDS] [--server NAME]
+//  277 --worker <scene.xml> [--server NAME]
+//The coordinator starts N workers itself, and workers started by hand with the same server name join in.
+
+//A scene, its BVH and its integrator, loaded from a scene file the way MyGL does
+class RenderJob
+{
+public:
+    RenderJob();
+    ~RenderJob();
+    bool Load(const QString &scene_path);
+
+    Scene scene;
+    IntersectionEngine intersection_engine;
+    Integrator* integrator;
+    XMLReader xml_reader;
+};
+
+//One unit of work: samples [sample_start, sample_end) of every pixel in [x0, x1) x [y0, y1)
+struct TileLease
+{
+    int x0, y0, x1, y1;
+    unsigned int sample_start, sample_end;
+};
+
+//Messages are a byte count followed by that many bytes, the first four holding a MessageType.
+//Both ends run the same binary on the same machine, so values are sent in memory layout.
+enum MessageType {MESSAGE_LEASE = 1, MESSAGE_RESULT = 2, MESSAGE_DONE = 3};
+
+//Cuts the image into tiles, and each tile's samples into ranges of scene.pass_samples, and leases them to workers
+//over a QLocalSocket, one at a time per worker. A lease goes back in the queue if its worker disconnects, and is
+//offered to another worker if it's out longer than lease_timeout; the first result to arrive for it is kept.
+//Workers the coordinator started are started again if they exit before the render is done.
+//A lease's result only depends on the scene, its tile and its sample range, and results are merged in lease order
+//however they arrive, so the film comes out the same for a given seed whatever the workers do. That holds for SPPM
+//and VCM too, whose radius follows the sample index, so a tile's leases converge like the GUI's passes over it.
+class RenderCoordinator
+{
+public:
+    RenderCoordinator(Scene &scene, const QString &server_name);
+    ~RenderCoordinator();
+
+    //Renders every sample of the scene into its film, resolved and with splats merged. False if the server
+    //can't listen, or if every worker it started has died too often while no other worker is connected.
+    bool Run();
+
+    unsigned int worker_count;//Processes to start
+    QString worker_program;
+    QStringList worker_arguments;
+    unsigned int max_restarts;//Across all workers
+    int tile_size;
+    int lease_timeout;//Milliseconds, 0 for none
+
+private:
+    struct Connection
+    {
+        QLocalSocket* socket;
+        QByteArray buffer;//Bytes received that don't make a whole message yet
+        int lease;//-1 when idle
+        QElapsedTimer leased;
+    };
+
+    void BuildLeases();
+    void StartWorkers();
+    bool ServiceConnection(Connection &c);//False once the worker is gone
+    void SendLease(Connection &c, int lease);
+    bool StoreResult(const QByteArray &message);//False if the message isn't a well-formed result
+    bool ValidResult(int lease, const QByteArray &message) const;//Whether message holds everything MergeResult reads for lease
+    void MergeResult(int lease, const QByteArray &message);
+
+    Scene &scene;
+    QString server_name;
+    QLocalServer server;
+    QList<QProcess*> processes;
+    QList<Connection> connections;
+    unsigned int restarts;
+
+    std::vector<TileLease> leases;
+    QQueue<int> pending;
+    std::vector<QByteArray> results;//Results waiting for the leases before them to be merged
+    std::vector<bool> done;
+    unsigned int remaining;
+    unsigned int next_merge;//Every lease before it has been merged into the film
+};
+
+//Takes leases from a coordinator until it says it's done or goes away, renders each with a RenderThread
+//into its own film and sends back the tile's (color * weight, weight) sums, border included, its AOVs and any splats
+class RenderWorker
+{
+public:
+    RenderWorker(Scene &scene, Integrator* integrator, const QString &server_name);
+    //0 once the coordinator is done, 1 if it couldn't be reached or a lease was bad
+    int Run();
+
+private:
+    QByteArray Render(int id, const TileLease &lease);
+
+    Scene &scene;
+    Integrator* integrator;
+    QString server_name;
+};
+
+//Runs a coordinator or worker from the command line above. False from IsHeadless means the GUI should start instead.
+bool IsHeadless(int argc, char *argv[]);
+int HeadlessMain(int argc, char *argv[]);
@@ -1,4 +1,5 @@
 #include <mainwindow.h>
+#include <headlessrender.h>
 
 #include <QApplication>
 #include <QSurfaceFormat>
@@ -21,6 +22,10 @@ void debugFormatVersion()
 
 int main(int argc, char *argv[])
 {
+    //--coordinator and --worker render without a window
+    if(IsHeadless(argc, argv))
+        return HeadlessMain(argc, argv);
+
     QApplication a(argc, argv);
 
     // Set OpenGL 3.2 and, optionally, 4-sample multisampling
@@ -37,6 +37,11 @@ void MainWindow::on_actionRender_triggered()
     ui->mygl->RaytraceScene();
 }
 
+void MainWindow::on_actionResume_Render_triggered()
+{
+    ui->mygl->ResumeRender();
+}
+
 void MainWindow::on_actionCamera_Controls_triggered()
 {
     CameraControlsHelp* c = new CameraControlsHelp();
@@ -25,6 +25,8 @@ private slots:
 
     void on_actionRender_triggered();
 
+    void on_actionResume_Render_triggered();
+
     void on_actionCamera_Controls_triggered();
 
 private:
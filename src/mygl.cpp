@@ -2,6 +2,7 @@
 #include <la.h>
 
 #include <iostream>
+#include <algorithm>
 #include <QApplication>
 #include <QKeyEvent>
 #include <QXmlStreamReader>
@@ -10,7 +11,6 @@
 #include <raytracing/samplers/stratifiedpixelsampler.h>
 #include <QtOpenGL/QGLWidget>
 #include <QLabel>
-#include <QOpenGLTexture>
 
 GLfloat vertexData[] = {
     //  X     Y     Z       U     V
@@ -25,12 +25,23 @@ MyGL::MyGL(QWidget *parent)
 {
     setFocusPolicy(Qt::ClickFocus);
     render_threads = NULL;
+    num_render_threads = 0;
+    threads_running = 0;
+    shown_film = render_film = &scene.film;
+    interactive = false;
+    preview_scale = 1;
+    cancelling = false;
+    frame_scheduled = false;
+    last_frame.start();
+    connect(&tile_queue, SIGNAL(Ready()), this, SLOT(DrainTiles()), Qt::QueuedConnection);
 }
 
 MyGL::~MyGL()
 {
+    StopRender();
     makeCurrent();
 
+    display.Destroy(*this);
     vao.destroy();
 }
 
@@ -124,10 +135,10 @@ void MyGL::paintGL()
 
         progressive_render.bind();
 
-        QOpenGLTexture texture(gfb);
-        texture.setMagnificationFilter(QOpenGLTexture::Linear);
-        texture.setMinificationFilter(QOpenGLTexture::LinearMipMapLinear);
-        texture.bind();
+        //Only what changed since the last repaint goes to the GPU
+        last_frame.restart();
+        glActiveTexture(GL_TEXTURE0);
+        display.Upload(*this, *shown_film);
 
         glBindBuffer(GL_ARRAY_BUFFER,vertexBufferId);
 
@@ -140,7 +151,6 @@ void MyGL::paintGL()
         glVertexAttribPointer(progressive_render.attributeLocation("vertTexCoord"), 2, GL_FLOAT, GL_TRUE,  5*sizeof(GLfloat), (const GLvoid*)(3 * sizeof(GLfloat)));
 
         glDrawArrays(GL_TRIANGLE_STRIP,0,4);
-        texture.destroy();
     }
 
 }
@@ -199,6 +209,10 @@ void MyGL::ResizeToSceneCamera()
 
 void MyGL::keyPressEvent(QKeyEvent *e)
 {
+    glm::vec3 eye = gl_camera.eye;
+    glm::vec3 ref = gl_camera.ref;
+    float fovy = gl_camera.fovy;
+
     float amount = 2.0f;
     if(e->modifiers() & Qt::ShiftModifier){
         amount = 10.0f;
@@ -232,18 +246,26 @@ void MyGL::keyPressEvent(QKeyEvent *e)
         gl_camera.TranslateAlongUp(amount);
     } else if (e->key() == Qt::Key_F) {
         gl_camera.CopyAttributes(scene.camera);
-    } else if (e->key() == Qt::Key_R) {
+    } else if (e->key() == Qt::Key_R && !interactive) {
+        //An interactive render copies the camera itself, once its threads are done with it
         scene.camera = Camera(gl_camera);
         scene.camera.recreate();
     } else if (e->key() == Qt::Key_O) {
         scene.film.WriteImage(filePath);
+    } else if (e->key() == Qt::Key_I) {
+        ToggleInteractive();
     }
     gl_camera.RecomputeAttributes();
+    if(interactive && (gl_camera.eye != eye || gl_camera.ref != ref || gl_camera.fovy != fovy))
+        RestartPreview();
     update();  // Calls paintGL, among other things
 }
 
 void MyGL::SceneLoadDialog()
 {
+    //The threads use the scene that's about to be cleared
+    StopRender();
+    interactive = false;
     currentState = Preview;
 
     QString filepath = QFileDialog::getOpenFileName(0, QString("Load Scene"), QString("../scene_files"), tr("*.xml"));
@@ -283,52 +305,66 @@ void MyGL::SceneLoadDialog()
 
 void MyGL::RaytraceScene()
 {
-    // set opengl shader state
-    gfb = grabFramebuffer();
-    gfb = gfb.scaled(QSize(scene.camera.width,scene.camera.height));
-
-    QString filepath = QFileDialog::getSaveFileName(0, QString("Save Image"), QString("../rendered_images"), tr("*.bmp"));
+    QString filepath = QFileDialog::getSaveFileName(0, QString("Save Image"), QString("../rendered_images"), tr("Images (*.bmp *.exr *.pfm)"));
     if(filepath.length() == 0)
     {
         return;
     }
     filePath = filepath;
-    currentState = Rendering;
+    StopRender();
+    interactive = false;
+    scene.film.ClearAccumulation();
+    StartRender();
+}
 
-#define MULTITHREADED
-#ifdef MULTITHREADED
-    //Set up 16 (max) threads
-    unsigned int width = scene.camera.width;
-    unsigned int height = scene.camera.height;
-    unsigned int x_block_size = (width >= 4 ? width/4 : 1);
-    unsigned int y_block_size = (height >= 4 ? height/4 : 1);
-    unsigned int x_block_count = width > 4 ? width/x_block_size : 1;
-    unsigned int y_block_count = height > 4 ? height/y_block_size : 1;
-    if(x_block_count * x_block_size < width) x_block_count++;
-    if(y_block_count * y_block_size < height) y_block_count++;
+void MyGL::ResumeRender()
+{
+    QString filepath = QFileDialog::getOpenFileName(0, QString("Resume Render"), QString("../rendered_images"), tr("*.ckpt"));
+    if(filepath.length() == 0)
+    {
+        return;
+    }
+    StopRender();
+    interactive = false;
+    //The scene has to be the one the checkpoint was rendered from; only its sample count may have gone up
+    const Sampler &sampler = integrator->GetSampler();
+    if(!scene.film.ReadCheckpoint(filepath.toStdString(), sampler.Name(), sampler.Seed()))
+    {
+        std::cout << "Could not resume from " << filepath.toStdString() << ": it is unreadable or from another image size or sampler" << std::endl;
+        return;
+    }
+    //Checkpoints are written as <image>.ckpt
+    filePath = filepath.endsWith(QString(".ckpt")) ? filepath.left(filepath.length() - 5) : filepath;
+    //Shows what the checkpoint holds until the first pass is done
+    unsigned int samples_done = *std::min_element(scene.film.sample_counts.begin(), scene.film.sample_counts.end());
+    scene.film.ResolveTiles();
+    scene.film.MergeSplats(1.0f / glm::max(samples_done, 1u));
+    StartRender();
+}
 
-    //unsigned int num_render_threads = x_block_count * y_block_count;
-    //RenderThread **render_threads = new RenderThread*[num_render_threads];
+void MyGL::StartRender()
+{
+    shown_film = render_film = &scene.film;
+    display.MarkAllDirty();
+    currentState = Rendering;
+    samples_target = scene.sqrt_samples * scene.sqrt_samples;
+    checkpoint_timer.start();
+    StartPass();
+}
 
-    num_render_threads = x_block_count * y_block_count;
-    render_threads = new RenderThread*[num_render_threads];
+void MyGL::StartPass()
+{
+    //Pixels pick up at their own sample counts, which are all the same between passes
+    unsigned int samples_done = *std::min_element(scene.film.sample_counts.begin(), scene.film.sample_counts.end());
+    pass_end = scene.pass_samples > 0 ? glm::min(samples_done + scene.pass_samples, samples_target) : samples_target;
+    //Interactive passes double the samples, so the image sharpens quickly at first
+    if(interactive)
+        pass_end = glm::min(glm::max(2 * samples_done, 1u), samples_target);
+    pass_end = glm::max(pass_end, samples_done);
 
-    //Launch the render threads we've made
-    for(unsigned int Y = 0; Y < y_block_count; Y++)
-    {
-        //Compute the columns of the image that the thread should render
-        unsigned int y_start = Y * y_block_size;
-        unsigned int y_end = glm::min((Y + 1) * y_block_size, height);
-        for(unsigned int X = 0; X < x_block_count; X++)
-        {
-            //Compute the rows of the image that the thread should render
-            unsigned int x_start = X * x_block_size;
-            unsigned int x_end = glm::min((X + 1) * x_block_size, width);
-            //Create and run the thread
-            render_threads[Y * x_block_count + X] = new RenderThread(x_start, x_end, y_start, y_end, scene.sqrt_samples, integrator->getMaxDepth(), &(scene.film), &(scene.camera), integrator, &gfb);
-            render_threads[Y * x_block_count + X]->start();
-        }
-    }
+#define MULTITHREADED
+#ifdef MULTITHREADED
+    LaunchThreads(&scene.film, &scene.camera, scene.filter, pass_end);
 
 //    bool still_running;
 //    do
@@ -359,52 +395,250 @@ void MyGL::RaytraceScene()
 //    delete [] render_threads;
 
 #else
-    StratifiedPixelSampler pixel_sampler(scene.sqrt_samples);
+    StratifiedPixelSampler pixel_sampler(scene.sqrt_samples, 0);
+    std::vector<glm::vec2> sample_points(pixel_sampler.SampleCount());
     for(unsigned int i = 0; i < scene.camera.width; i++)
     {
         for(unsigned int j = 0; j < scene.camera.height; j++)
         {
-            QList<glm::vec2> sample_points = pixel_sampler->GetSamples(i, j);
+            unsigned int count = pixel_sampler.GetSamples(i, j, sample_points.data(), sample_points.size());
             glm::vec3 accum_color;
-            for(int a = 0; a < sample_points.size(); a++)
+            for(unsigned int a = 0; a < count; a++)
             {
-                glm::vec3 color = integrator.TraceRay(scene.camera.Raycast(sample_points[a]), 0);
+                glm::vec3 color = integrator->TraceRay(scene.camera.Raycast(sample_points[a]), 0);
                 accum_color += color;
             }
-            scene.film.pixels[i][j] = accum_color / (float)sample_points.size();
+            scene.film.Pixel(i, j) = accum_color / (float)count;
         }
     }
 #endif
     //scene.film.WriteImage(filepath);
-    QTimer::singleShot(500,this,SLOT(updateRender()));
     //currentState = Preview;
 }
 
-void MyGL::updateRender()
+void MyGL::LaunchThreads(Film* film, Camera* camera, Filter* filter, unsigned int sample_end)
 {
-    bool still_running ;
-    still_running = false;
+    //Set up 16 (max) threads
+    unsigned int width = film->width;
+    unsigned int height = film->height;
+    unsigned int x_block_size = (width >= 4 ? width/4 : 1);
+    unsigned int y_block_size = (height >= 4 ? height/4 : 1);
+    unsigned int x_block_count = width > 4 ? width/x_block_size : 1;
+    unsigned int y_block_count = height > 4 ? height/y_block_size : 1;
+    if(x_block_count * x_block_size < width) x_block_count++;
+    if(y_block_count * y_block_size < height) y_block_count++;
 
-    myUpdate();
+    //unsigned int num_render_threads = x_block_count * y_block_count;
+    //RenderThread **render_threads = new RenderThread*[num_render_threads];
 
-    for(unsigned int i = 0; i < num_render_threads; i++)
+    num_render_threads = x_block_count * y_block_count;
+    render_threads = new RenderThread*[num_render_threads];
+    threads_running = num_render_threads;
+
+    //A pending full upload reads every pixel, so it's done before any thread writes one.
+    //While they run, paintGL only uploads the rows they've reported.
+    makeCurrent();
+    glActiveTexture(GL_TEXTURE0);
+    display.Upload(*this, *shown_film);
+    doneCurrent();
+
+    //Launch the render threads we've made
+    for(unsigned int Y = 0; Y < y_block_count; Y++)
     {
-        if(render_threads[i]->isRunning())
+        //Compute the columns of the image that the thread should render
+        unsigned int y_start = Y * y_block_size;
+        unsigned int y_end = glm::min((Y + 1) * y_block_size, height);
+        for(unsigned int X = 0; X < x_block_count; X++)
         {
-            still_running = true;
-            QTimer::singleShot(500,this,SLOT(updateRender()));
-            return;
+            //Compute the rows of the image that the thread should render
+            unsigned int x_start = X * x_block_size;
+            unsigned int x_end = glm::min((X + 1) * x_block_size, width);
+            //Create and run the thread
+            render_threads[Y * x_block_count + X] = new RenderThread(x_start, x_end, y_start, y_end, sample_end, integrator->getMaxDepth(), film, camera, integrator, &tile_queue, filter);
+            render_threads[Y * x_block_count + X]->start();
         }
     }
+}
+
+void MyGL::DrainTiles()
+{
+    for(const TileQueue::Event &e : tile_queue.Drain())
+    {
+        if(e.finished)
+            threads_running--;
+        else if(render_film == shown_film)
+            display.MarkDirty(e.rect);
+    }
+    if(num_render_threads > 0 && threads_running == 0)
+        FinishPass();
+    RequestFrame();
+}
+
+void MyGL::RequestFrame()
+{
+    if(frame_scheduled)
+        return;
+    qint64 wait = min_frame_interval - last_frame.elapsed();
+    if(wait <= 0)
+    {
+        myUpdate();
+        return;
+    }
+    //Updates until then are picked up by that frame
+    frame_scheduled = true;
+    QTimer::singleShot(int(wait), this, SLOT(ScheduledFrame()));
+}
+
+void MyGL::ScheduledFrame()
+{
+    frame_scheduled = false;
+    myUpdate();
+}
 
+void MyGL::DeleteThreads()
+{
+    for(unsigned int i = 0; i < num_render_threads; i++)
+    {
+        //A thread reports it's finished just before it returns from run
+        render_threads[i]->wait();
+        delete render_threads[i];
+    }
+    delete [] render_threads;
+    render_threads = NULL;
+    num_render_threads = 0;
+}
+
+void MyGL::StopRender()
+{
+    for(unsigned int i = 0; i < num_render_threads; i++)
+        render_threads[i]->Cancel();
+    DeleteThreads();
+    //Their reports are stale now; a Ready still on its way finds the queue empty
+    tile_queue.Drain();
+    threads_running = 0;
+    cancelling = false;
+}
+
+void MyGL::FinishPass()
+{
     //Finally, clean up the render thread objects
-    if(!still_running)
+    DeleteThreads();
+    if(cancelling)
     {
-        scene.film.WriteImage(filePath);
-        for(unsigned int i = 0; i < num_render_threads; i++)
+        cancelling = false;
+        StartPreview();
+        return;
+    }
+    if(render_film != &scene.film)
+    {
+        //A preview level is done: it replaces the coarser one on screen while the next is traced
+        render_film->ResolveTiles();
+        shown_film = render_film;
+        display.MarkAllDirty();
+        preview_scale /= 2;
+        StartPreviewLevel();
+        return;
+    }
+    {
+        //Every pass adds to the film's sums, so resolving them gives the image over all passes so far
+        scene.film.ResolveTiles();
+        //Each camera sample traced one light path, so the splats are averaged over the samples per pixel
+        scene.film.MergeSplats(1.0f / glm::max(pass_end, 1u));
+
+        bool finished = pass_end >= samples_target;
+        if(!interactive && scene.checkpoint_interval > 0 && (finished || checkpoint_timer.elapsed() >= scene.checkpoint_interval * 1000))
         {
-            delete render_threads[i];
+            const Sampler &sampler = integrator->GetSampler();
+            if(!scene.film.WriteCheckpoint((filePath + QString(".ckpt")).toStdString(), sampler.Name(), sampler.Seed()))
+                std::cout << "Could not write the checkpoint for " << filePath.toStdString() << std::endl;
+            checkpoint_timer.restart();
+        }
+        //Resolving and splats changed every pixel. The first pass of an interactive render is also when
+        //the film takes over from the last preview level.
+        shown_film = &scene.film;
+        display.MarkAllDirty();
+        if(!finished)
+        {
+            StartPass();
+            return;
         }
-        delete [] render_threads;
+
+        if(scene.denoiser != NULL)
+        {
+            scene.denoiser->Run(scene.film);
+            display.MarkAllDirty();
+        }
+        RequestFrame();
+
+        if(!interactive)
+            scene.film.WriteImage(filePath);
+    }
+}
+
+void MyGL::ToggleInteractive()
+{
+    StopRender();
+    interactive = !interactive;
+    if(!interactive)
+    {
+        currentState = Preview;
+        return;
+    }
+    currentState = Rendering;
+    StartPreview();
+}
+
+void MyGL::RestartPreview()
+{
+    if(num_render_threads == 0)
+    {
+        StartPreview();
+        return;
+    }
+    //The threads stop after the rows they're tracing and FinishPass starts over once they all have,
+    //so any number of moves before then cost one restart
+    for(unsigned int i = 0; i < num_render_threads; i++)
+        render_threads[i]->Cancel();
+    cancelling = true;
+}
+
+void MyGL::StartPreview()
+{
+    //Only copied once no thread is using the scene camera
+    scene.camera = Camera(gl_camera);
+    scene.camera.recreate();
+    if(scene.film.width != scene.camera.width || scene.film.height != scene.camera.height)
+        scene.film.SetDimensions(scene.camera.width, scene.camera.height);
+    preview_scale = preview_start_scale;
+    StartPreviewLevel();
+}
+
+void MyGL::StartPreviewLevel()
+{
+    if(preview_scale <= 1)
+    {
+        //The last preview level stays on screen until the film's first pass is done
+        scene.film.ClearAccumulation();
+        render_film = &scene.film;
+        samples_target = scene.sqrt_samples * scene.sqrt_samples;
+        StartPass();
+        return;
+    }
+
+    //Same view with fewer pixels: H and V are kept, so only the pixel size changes
+    preview_camera = Camera(scene.camera);
+    preview_camera.width = glm::max((scene.camera.width + preview_scale - 1) / preview_scale, 1u);
+    preview_camera.height = glm::max((scene.camera.height + preview_scale - 1) / preview_scale, 1u);
+
+    render_film = shown_film == &preview_films[0] ? &preview_films[1] : &preview_films[0];
+    render_film->SetDimensions(preview_camera.width, preview_camera.height);
+    //Nothing is left to show from before the camera moved, so the first level is shown as it's traced
+    if(preview_scale == preview_start_scale)
+    {
+        shown_film = render_film;
+        display.MarkAllDirty();
     }
+    //One unfiltered sample per pixel. Light paths a bidirectional integrator splats land in the scene's film,
+    //which is cleared before the full size level, so previews lack those strategies' share.
+    LaunchThreads(render_film, &preview_camera, NULL, 1);
 }
@@ -14,7 +14,10 @@
 #include <scene/xmlreader.h>
 #include <raytracing/integrator.h>
 #include <qpainter.h>
+#include <QElapsedTimer>
 #include <renderthread.h>
+#include <openGL/progressivedisplay.h>
+#include <tilequeue.h>
 
 class RenderThread;
 
@@ -52,13 +55,14 @@ public:
     void ResizeToSceneCamera();
 
     void RaytraceScene();
+    //Continues a render from a checkpoint up to the scene's current sample count
+    void ResumeRender();
 
-    //unsigned char* pixBuffer;
-    QImage gfb; // frame buffer
-    QImage gldata; // converted to  gl version
+    ProgressiveDisplay display;//What the render threads have drawn into shown_film so far
+    Film* shown_film;//Either the scene's film or a preview film
+    Film* render_film;//Film the running threads render into
     enum State {Rendering,Preview};
     State currentState;
-    GLuint textureID;
 
     GLuint vertexBufferId;
 
@@ -70,6 +74,44 @@ public:
     RenderThread** render_threads;
     unsigned int num_render_threads;
 
+    //A render is a series of passes, each adding up to scene.pass_samples samples to every pixel
+    unsigned int samples_target;
+    unsigned int pass_end;//Sample count every pixel reaches when the running pass is done
+    QElapsedTimer checkpoint_timer;//Since the last checkpoint
+    void StartRender();
+    void StartPass();
+    void FinishPass();
+    //Splits film into blocks and starts a thread on each, tracing every pixel up to sample_end samples
+    void LaunchThreads(Film* film, Camera* camera, Filter* filter, unsigned int sample_end);
+    //Waits for the render threads and deletes them
+    void DeleteThreads();
+    //Cancels the running threads, waits for them and forgets what they reported
+    void StopRender();
+
+    //Interactive preview, toggled with I: the scene camera follows gl_camera, and the render starts over whenever it
+    //moves. The first level is traced at 1/preview_start_scale of the resolution, each next level at twice the one
+    //before, shown once it's done, and at full size passes double the samples until the scene's count is reached.
+    bool interactive;
+    static const unsigned int preview_start_scale = 8;
+    unsigned int preview_scale;//Resolution divisor of the level being traced, 1 once it's the scene's film
+    Camera preview_camera;//The scene camera with fewer, bigger pixels
+    Film preview_films[2];//One being traced, the other on screen
+    bool cancelling;//The threads were cancelled by a camera move, so the preview starts over once they're done
+    void ToggleInteractive();
+    void RestartPreview();
+    void StartPreview();
+    void StartPreviewLevel();
+
+    //Render threads' progress arrives here; the pass is over once every thread has said it's finished
+    TileQueue tile_queue;
+    unsigned int threads_running;
+
+    //Repaints while rendering are at most this many milliseconds apart, whatever the threads report
+    static const int min_frame_interval = 33;
+    QElapsedTimer last_frame;
+    bool frame_scheduled;
+    void RequestFrame();
+
 protected:
     void keyPressEvent(QKeyEvent *e);
 
@@ -77,7 +119,7 @@ signals:
     void sig_ResizeToCamera(int,int);
 
 public slots:
-    void updateRender();
-    //void updateRender(RenderThread** render_threads,unsigned int num_render_threads);
+    void DrainTiles();
+    void ScheduledFrame();
 
 };
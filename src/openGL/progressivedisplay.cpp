@@ -0,0 +1,113 @@
+#include <openGL/progressivedisplay.h>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+bool LeftThenTop(const QRect &a, const QRect &b)
+{
+    return a.x() != b.x() ? a.x() < b.x() : a.y() < b.y();
+}
+}
+
+ProgressiveDisplay::ProgressiveDisplay() : texture(0), pixel_buffer(0), width(0), height(0), all_dirty(true)
+{}
+
+void ProgressiveDisplay::MarkDirty(const QRect &r)
+{
+    dirty.append(r);
+}
+
+void ProgressiveDisplay::MarkAllDirty()
+{
+    dirty.clear();
+    all_dirty = true;
+}
+
+void ProgressiveDisplay::Create(GLWidget277 &f, unsigned int w, unsigned int h)
+{
+    Destroy(f);
+    width = w;
+    height = h;
+
+    f.glGenTextures(1, &texture);
+    f.glBindTexture(GL_TEXTURE_2D, texture);
+    //Shown at the film's own size, so no mipmaps
+    f.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    f.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    f.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    f.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    f.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    //Same layout as Film::pixels, so rows go across without conversion
+    f.glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, width, height, 0, GL_RGB, GL_FLOAT, NULL);
+
+    f.glGenBuffers(1, &pixel_buffer);
+    f.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer);
+    f.glBufferData(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(width) * height * sizeof(glm::vec3), NULL, GL_STREAM_DRAW);
+    f.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    MarkAllDirty();
+}
+
+void ProgressiveDisplay::Destroy(GLWidget277 &f)
+{
+    if(texture != 0)
+        f.glDeleteTextures(1, &texture);
+    if(pixel_buffer != 0)
+        f.glDeleteBuffers(1, &pixel_buffer);
+    texture = pixel_buffer = 0;
+    width = height = 0;
+}
+
+void ProgressiveDisplay::Upload(GLWidget277 &f, const Film &film)
+{
+    if(texture == 0 || film.width != width || film.height != height)
+        Create(f, film.width, film.height);
+
+    QList<QRect> rects;
+    if(all_dirty)
+        rects.append(QRect(0, 0, width, height));
+    else
+        rects.swap(dirty);
+    dirty.clear();
+    all_dirty = false;
+    //Render threads report a tile's rows a few at a time, so runs of them join into one rectangle
+    std::sort(rects.begin(), rects.end(), LeftThenTop);
+    QList<QRect> merged;
+    for(const QRect &r : rects)
+    {
+        QRect c = r.intersected(QRect(0, 0, width, height));
+        if(c.isEmpty())
+            continue;
+        if(!merged.isEmpty() && merged.last().left() == c.left() && merged.last().right() == c.right()
+                && merged.last().bottom() + 1 >= c.top())
+            merged.last() = merged.last().united(c);
+        else
+            merged.append(c);
+    }
+
+    f.glBindTexture(GL_TEXTURE_2D, texture);
+    if(merged.isEmpty())
+        return;
+    f.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer);
+    f.glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+    f.glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    for(const QRect &r : merged)
+    {
+        //Each rectangle goes where it sits in the film, so the buffer has the film's row pitch
+        GLintptr first = (GLintptr(r.top()) * width + r.left()) * sizeof(glm::vec3);
+        GLintptr last = (GLintptr(r.bottom()) * width + r.right() + 1) * sizeof(glm::vec3);
+        char *mapped = static_cast<char*>(f.glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, first, last - first,
+                                                              GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
+        if(mapped == NULL)
+            continue;
+        //Drained rows are done for the pass: TileQueue orders their pixels before the report that names them
+        for(int y = r.top(); y <= r.bottom(); y++)
+            std::memcpy(mapped + (GLintptr(y) * width + r.left()) * sizeof(glm::vec3) - first,
+                        &film.pixels[y * width + r.left()], r.width() * sizeof(glm::vec3));
+        f.glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        f.glTexSubImage2D(GL_TEXTURE_2D, 0, r.left(), r.top(), r.width(), r.height(), GL_RGB, GL_FLOAT,
+                          reinterpret_cast<const GLvoid*>(first));
+    }
+    f.glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    f.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <openGL/glwidget277.h>
+#include <raytracing/film.h>
+#include <QRect>
+#include <QList>
+
+//The image shown while rendering: one float texture kept for the whole render and updated only where it changed.
+//Render threads write their pixels straight into the Film and report the rectangles through a TileQueue,
+//which MyGL passes on to MarkDirty.
+//On the GL thread Upload copies just those rows into a pixel buffer object and has the texture read them from it
+//with glTexSubImage2D, so the transfer itself runs asynchronously. The texture holds the film's linear radiance;
+//progressive.frag.glsl maps it to the screen.
+class ProgressiveDisplay
+{
+public:
+    ProgressiveDisplay();
+
+    void MarkDirty(const QRect &r);
+    void MarkAllDirty();
+
+    //Uploads the dirty parts of film, first (re)allocating the texture and buffer if film's size changed,
+    //and binds the texture to the active texture unit.
+    //A full upload reads every pixel, so after MarkAllDirty or a resize it may only run while no thread renders into film.
+    void Upload(GLWidget277 &f, const Film &film);
+    void Destroy(GLWidget277 &f);
+
+private:
+    void Create(GLWidget277 &f, unsigned int width, unsigned int height);
+
+    GLuint texture, pixel_buffer;
+    unsigned int width, height;
+    QList<QRect> dirty;
+    bool all_dirty;
+};
@@ -0,0 +1,96 @@
+#pragma once
+#include <la.h>
+#include <raytracing/intersection.h>
+
+//Arbitrary output variables of one camera sample, or of one pixel once averaged into the Film.
+//Features come from the camera ray's first hit and are what denoisers and compositing work from;
+//direct and indirect split the sample's radiance by whether the light reached the first hit straight from an emitter.
+struct AOVSample
+{
+    glm::vec3 albedo;//base_color * texture_color at the first hit
+    glm::vec3 normal;//World-space normal at the first hit
+    glm::vec3 direct;//Emission seen by the camera plus direct lighting at the first hit
+    glm::vec3 indirect;//Everything that took at least one more bounce
+    float depth;//Intersection::t of the first hit, 0 on a miss
+    float object_id;//Geometry::id of the first hit, -1 on a miss
+    float material_id;//Material::id of the first hit, -1 on a miss
+    float variance;//Variance of a pixel's mean luminance, estimated from its samples' spread; 0 for a single sample
+
+    //Set once an integrator has filled in the first hit or split its radiance,
+    //so Integrator::TraceRays only fills in what the integrator didn't
+    bool has_first_hit;
+    bool has_split;
+
+    AOVSample() : albedo(0), normal(0), direct(0), indirect(0), depth(0), object_id(-1), material_id(-1),
+        variance(0), has_first_hit(false), has_split(false){}
+
+    void SetFirstHit(const Intersection &isx)
+    {
+        has_first_hit = true;
+        if(isx.t <= 0 || isx.object_hit == NULL)
+            return;
+        albedo = isx.object_hit->material->base_color * isx.texture_color;
+        normal = isx.normal;
+        depth = isx.t;
+        object_id = isx.object_hit->id;
+        material_id = isx.object_hit->material->id;
+    }
+
+    //The pixel value of n samples: the mean of each AOV, except the IDs, which come from the first sample
+    static AOVSample Average(const AOVSample *samples, unsigned int n)
+    {
+        AOVSample result;
+        if(n == 0)
+            return result;
+        float sum_l = 0, sum_l2 = 0;
+        for(unsigned int i = 0; i < n; i++)
+        {
+            glm::vec3 L = samples[i].direct + samples[i].indirect;
+            float l = 0.2126f * L.r + 0.7152f * L.g + 0.0722f * L.b;
+            sum_l += l;
+            sum_l2 += l * l;
+            result.albedo += samples[i].albedo;
+            result.normal += samples[i].normal;
+            result.direct += samples[i].direct;
+            result.indirect += samples[i].indirect;
+            result.depth += samples[i].depth;
+        }
+        float inv = 1.0f / n;
+        result.albedo *= inv;
+        result.normal *= inv;
+        result.direct *= inv;
+        result.indirect *= inv;
+        result.depth *= inv;
+        if(n > 1)
+            result.variance = glm::max(sum_l2 - sum_l * sum_l * inv, 0.0f) / (n - 1) * inv;
+        result.object_id = samples[0].object_id;
+        result.material_id = samples[0].material_id;
+        result.has_first_hit = result.has_split = true;
+        return result;
+    }
+
+    //Folds b, the average of nb more samples, into this average of na samples. The IDs stay this one's.
+    void Merge(const AOVSample &b, unsigned int na, unsigned int nb)
+    {
+        if(nb == 0)
+            return;
+        float wa = float(na) / (na + nb), wb = float(nb) / (na + nb);
+        albedo = albedo * wa + b.albedo * wb;
+        normal = normal * wa + b.normal * wb;
+        direct = direct * wa + b.direct * wb;
+        indirect = indirect * wa + b.indirect * wb;
+        depth = depth * wa + b.depth * wb;
+        //The two means are independent, so their variances add with the squared weights
+        variance = variance * wa * wa + b.variance * wb * wb;
+    }
+
+    //Adds radiance that reached the camera after bounces bounces past the first hit
+    void AddRadiance(const glm::vec3 &L, unsigned int bounces)
+    {
+        has_split = true;
+        if(bounces == 0)
+            direct += L;
+        else
+            indirect += L;
+    }
+};
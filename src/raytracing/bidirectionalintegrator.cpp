@@ -1,78 +1,271 @@
 #include <raytracing/bidirectionalintegrator.h>
 
+//Strategies that cannot sample a node give a density of 0; counting it as 1 keeps the ratios finite
+static inline float Remap0(float f)
+{
+    return f != 0 ? f : 1.0f;
+}
+
+static inline float RatioSquared(float pdfRev, float pdfFwd)
+{
+    float r = Remap0(pdfRev) / Remap0(pdfFwd);
+    return r * r;
+}
+
+//Whether a path can be split between node i-1 and node i by a connection, given whether it scatters through a delta at node i.
+//The delta flags say what the path does; a connection cannot reproduce a specular bounce at either end.
+static inline bool Connectable(const std::vector<PathNode> &path, int i, bool delta)
+{
+    return !delta && !(i > 0 && path[i-1].delta);
+}
+
+//Merging needs a light node reached by scattering, so never a light's own origin nor a specular bounce
+static inline bool Mergeable(const PathNode &v, bool delta)
+{
+    return !delta && !v.on_light;
+}
+
 BidirectionalIntegrator::BidirectionalIntegrator()
 {
     // constructor
 }
-std::vector<PathNode> BidirectionalIntegrator::generateEyePath(Ray r)
+
+float BidirectionalIntegrator::ConvertDensity(float pdf, const PathNode &from, const PathNode &to)
 {
-    std::vector<PathNode> eyePath;
-    eyePath.clear();
+    glm::vec3 w = to.isx.point - from.isx.point;
+    float dist2 = glm::length2(w);
+    if(dist2 == 0)
+        return 0;
+    return pdf * glm::abs(glm::dot(to.isx.normal, w)) / (dist2 * glm::sqrt(dist2));
+}
+
+float BidirectionalIntegrator::PdfScatter(const PathNode &v, const glm::vec3 &wo_world, const PathNode &next)
+{
+    glm::vec3 wi_world = glm::normalize(next.isx.point - v.isx.point);
+    float pdf;
+    v.isx.object_hit->material->EvaluateScatteredEnergy(v.isx,
+                                                        v.isx.ToLocalNormalCoordinate(glm::normalize(wo_world)),
+                                                        v.isx.ToLocalNormalCoordinate(wi_world),
+                                                        pdf);
+    //A specular lobe has no density toward any direction it was not sampled in
+    if(isinf(pdf))
+        return 0;
+    return ConvertDensity(pdf, v, next);
+}
+
+float BidirectionalIntegrator::PdfEmit(const PathNode &v, const PathNode &next)
+{
+    //Lights emit cosine-distributed over the hemisphere around their normal
+    float cosTheta = glm::dot(v.isx.normal, glm::normalize(next.isx.point - v.isx.point));
+    if(cosTheta <= 0)
+        return 0;
+    return ConvertDensity(cosTheta * INV_PI, v, next);
+}
+
+float BidirectionalIntegrator::PdfLightOrigin(const PathNode &v)
+{
+    Geometry* light = v.isx.object_hit;
+    return scene->light_sampler.Pdf(light) / light->area;
+}
+
+glm::vec3 BidirectionalIntegrator::Le(const PathNode &v, const glm::vec3 &w_world)
+{
+    float pdf;
+    return v.isx.object_hit->material->EvaluateScatteredEnergy(v.isx, w_world, w_world, pdf);
+}
+
+bool BidirectionalIntegrator::CameraConnectable() const
+{
+    return scene->camera.lensRadius <= 0;
+}
+
+PathNode BidirectionalIntegrator::CameraNode() const
+{
+    PathNode cam;
+    cam.isx.point = scene->camera.eye;
+    cam.isx.normal = scene->camera.look;
+    cam.isx.object_hit = NULL;
+    cam.beta = glm::vec3(1.0f);
+    cam.pdfFwd = cam.pdfRev = 0;
+    cam.delta = false;
+    cam.connectable = true;
+    cam.on_light = false;
+    cam.misSum = 0;
+    return cam;
+}
+
+float BidirectionalIntegrator::CameraPdfDir(const glm::vec3 &w_world) const
+{
+    //Rays are spread uniformly over the image plane at distance 1, whose area element is dA = dw / cos^3
+    float cosTheta = glm::dot(glm::normalize(w_world), scene->camera.look);
+    if(cosTheta <= 0)
+        return 0;
+    return 1.0f / (scene->camera.ImagePlaneArea() * cosTheta * cosTheta * cosTheta);
+}
 
-    Intersection isx = intersection_engine->GetIntersection(r);
-    int depth=0;
-    while(depth<max_depth && isx.t > 0)
+void BidirectionalIntegrator::RandomWalk(Ray r, glm::vec3 beta, float pdfDir, std::vector<PathNode> &path, int maxNodes)
+{
+    while(int(path.size()) < maxNodes)
     {
+        Intersection isx = intersection_engine->GetIntersection(r);
+        if(isx.t <= 0)
+            break;
+
         // store the path node
         PathNode node;
         node.isx = isx;
+        node.beta = beta;
         node.dirIn_world = -r.direction;
         node.dirIn_local = isx.ToLocalNormalCoordinate(-r.direction);
-        node.F = isx.object_hit->material->SampleAndEvaluateScatteredEnergy(isx,node.dirIn_local,node.dirOut_local,node.pdf);
-        node.dirOut_world = isx.ToWorldNormalCoordinate(node.dirOut_local);
-
-        if(node.pdf != 0)
-            eyePath.push_back(node);
-        else
+        node.F = glm::vec3(0);
+        node.pdf = 0;
+        node.pdfFwd = path.empty() ? 0 : ConvertDensity(pdfDir, path.back(), node);
+        node.pdfRev = 0;
+        node.delta = false;
+        node.connectable = isx.object_hit->material->HasNonDelta();
+        node.on_light = isx.object_hit->material->is_light_source;
+        node.misSum = 0;
+        path.push_back(node);
+
+        //Lights have no BxDFs, so a subpath ends on them
+        if(node.on_light)
             break;
 
-        //update r
-        r = Ray(isx.point + glm::sign(glm::dot(node.dirOut_world,isx.normal)) * isx.normal*1e-3f, node.dirOut_world);
+        PathNode &cur = path.back();
+        cur.F = SampleBSDF(isx,cur.dirIn_local,cur.dirOut_local,cur.pdf);
+        if(cur.pdf == 0 || (cur.F.x == 0 && cur.F.y == 0 && cur.F.z == 0))
+            break;
+        cur.dirOut_world = isx.ToWorldNormalCoordinate(cur.dirOut_local);
 
-        // update isx and depth info
-        depth++;
-        isx = intersection_engine->GetIntersection(r);
+        //Density of the reverse step, from cur back to the node before it
+        float pdfRev = 0;
+        if(isinf(cur.pdf))
+        {
+            //Delta lobes return F already divided by their pdf
+            cur.delta = true;
+            beta *= cur.F;
+            pdfDir = 0;
+        }
+        else
+        {
+            beta *= cur.F * glm::abs(glm::dot(cur.dirOut_world,isx.normal)) / cur.pdf;
+            pdfDir = cur.pdf;
+            isx.object_hit->material->EvaluateScatteredEnergy(isx,cur.dirOut_local,cur.dirIn_local,pdfRev);
+            if(isinf(pdfRev))
+                pdfRev = 0;
+        }
+        if(path.size() > 1)
+            path[path.size()-2].pdfRev = ConvertDensity(pdfRev, cur, path[path.size()-2]);
 
+        //update r
+        r = Ray(isx.point + glm::sign(glm::dot(cur.dirOut_world,isx.normal)) * isx.normal*1e-3f, cur.dirOut_world);
     }
+}
 
+std::vector<PathNode> BidirectionalIntegrator::generateEyePath(Ray r)
+{
+    std::vector<PathNode> eyePath;
+    eyePath.reserve(max_depth);
+
+    RandomWalk(r, glm::vec3(1.0f), 0, eyePath, max_depth);
+    //The camera is not stored as a node, but weighting light paths connected to it needs its density of the first hit
+    if(!eyePath.empty() && CameraConnectable())
+        eyePath[0].pdfFwd = ConvertDensity(CameraPdfDir(r.direction), CameraNode(), eyePath[0]);
+    AccumulateEyeRatios(eyePath);
     return eyePath;
 }
 
-std::vector<PathNode> BidirectionalIntegrator::generateLightPath(Geometry* &light)
+std::vector<PathNode> BidirectionalIntegrator::generateLightPath(Geometry* &light, float selectPdf)
 {
     std::vector<PathNode> lightPath;
-    lightPath.clear();
-
-    Intersection lightSample = light->RandomSampleOnSurface(uniform_distribution(generator),uniform_distribution(generator));
-
-    Ray r(lightSample.point, lightSample.point - light->transform.position());
+    lightPath.reserve(max_depth);
+
+    //The first node is the emitting point itself, sampled uniformly by area
+    glm::vec2 u = Get2D();
+    Intersection lightSample = light->RandomSampleOnSurface(u.x, u.y);
+    if(lightSample.object_hit == NULL)
+        return lightPath;
+    lightSample.object_hit = light;
+
+    PathNode origin;
+    origin.isx = lightSample;
+    origin.pdfFwd = selectPdf / light->area;
+    origin.pdfRev = 0;
+    origin.beta = glm::vec3(1.0f / origin.pdfFwd);
+    origin.delta = false;
+    origin.connectable = true;
+    origin.on_light = true;
+
+    //Cosine-weighted emission direction
+    u = Get2D();
+    float costheta = glm::sqrt(u.x);
+    float sintheta = glm::sqrt(glm::max(0.0f, 1.0f - costheta*costheta));
+    float phi = u.y * TWO_PI;
+    origin.dirOut_local = glm::vec3(sintheta * glm::cos(phi), sintheta * glm::sin(phi), costheta);
+    origin.dirOut_world = lightSample.ToWorldNormalCoordinate(origin.dirOut_local);
+    origin.pdf = costheta * INV_PI;
+    origin.F = Le(origin, origin.dirOut_world);
+    if(origin.pdf <= 0)
+        return lightPath;
+    lightPath.push_back(origin);
+
+    glm::vec3 beta = origin.beta * origin.F * costheta / origin.pdf;
+    Ray r(lightSample.point + 1e-3f * lightSample.normal, origin.dirOut_world);
+
+    //Connecting to the camera uses the whole path, so the light side may hold max_depth nodes too
+    RandomWalk(r, beta, origin.pdf, lightPath, max_depth);
+    AccumulateLightRatios(lightPath);
+    return lightPath;
+}
 
-    Intersection isx = intersection_engine->GetIntersection(r);
-    int depth = 0;
-    while(isx.t > 0 && depth < max_depth)
+void BidirectionalIntegrator::AccumulateEyeRatios(std::vector<PathNode> &eyePath)
+{
+    //The pdfRev of the last node is only known per connection, so its misSum stops short of it
+    int lastEye = CameraConnectable() ? 0 : 1;
+    for(int i = 0; i < int(eyePath.size()); i++)
     {
-        // store pathnode on the light path
-        PathNode node;
-        node.isx = isx;
-        node.dirIn_world = -r.direction;
-        node.dirIn_local = isx.ToLocalNormalCoordinate(-r.direction);
-        node.F = isx.object_hit->material->SampleAndEvaluateScatteredEnergy(isx,node.dirIn_local,node.dirOut_local,node.pdf);
-        node.dirOut_world = isx.ToWorldNormalCoordinate(node.dirOut_local);
-
-        if(node.pdf != 0)
-            lightPath.push_back(node);
-        else
-            break;
+        eyePath[i].misSum = Connectable(eyePath, i, eyePath[i].delta) ? 1 : 0;
+        if(i > 0)
+            eyePath[i].misSum += EyeNodeRatioSum(eyePath[i-1], eyePath[i-1].pdfRev, eyePath[i-1].misSum,
+                                                 eyePath[i-1].delta, i-1 >= lastEye);
+    }
+}
 
-        //update r
-        r = Ray(isx.point + glm::sign(glm::dot(node.dirOut_world,isx.normal)) * isx.normal*1e-3f, node.dirOut_world);
+void BidirectionalIntegrator::AccumulateLightRatios(std::vector<PathNode> &lightPath)
+{
+    for(int i = 0; i < int(lightPath.size()); i++)
+    {
+        lightPath[i].misSum = LightNodeTerms(lightPath, i, lightPath[i].delta);
+        if(i > 0)
+            lightPath[i].misSum += RatioSquared(lightPath[i-1].pdfRev, lightPath[i-1].pdfFwd) * lightPath[i-1].misSum;
+    }
+}
 
-        // update isx and depth info
-        depth++;
-        isx = intersection_engine->GetIntersection(r);
+float BidirectionalIntegrator::EyeNodeRatioSum(const PathNode &v, float pdfRev, float inner, bool delta, bool movable) const
+{
+    float sum = 0;
+    if(Mergeable(v, delta))
+    {
+        //A density of 0 from a specular bounce stands for the same delta in every strategy, as in the ratios
+        float merge = MergeRatio(Remap0(pdfRev));
+        sum += merge * merge;
     }
+    //Handing the first eye node over too is the camera connection, which only a pinhole has
+    if(movable)
+        sum += RatioSquared(pdfRev, v.pdfFwd) * inner;
+    return sum;
+}
 
-    return lightPath;
+float BidirectionalIntegrator::LightNodeTerms(const std::vector<PathNode> &lightPath, int i, bool delta) const
+{
+    //Area lights are never delta, so the origin can always be connected to
+    float sum = Connectable(lightPath, i, delta) ? 1 : 0;
+    if(i > 0 && Mergeable(lightPath[i], delta))
+    {
+        float merge = MergeRatio(Remap0(lightPath[i].pdfFwd));
+        sum += merge * merge;
+    }
+    return sum;
 }
 
 float BidirectionalIntegrator::G(PathNode &a, PathNode &b)
@@ -84,199 +277,189 @@ float BidirectionalIntegrator::G(PathNode &a, PathNode &b)
 
 bool BidirectionalIntegrator::isBlocked(const Intersection &isx1, const Intersection &isx2)
 {
-    glm::vec3 direction =glm::normalize(isx2.point - isx1.point);
+    glm::vec3 direction = isx2.point - isx1.point;
+    float dist = glm::length(direction);
+    direction /= dist;
     Ray r(isx1.point + 1e-3f*direction,direction);
     Intersection inter = intersection_engine->GetIntersection(r);
-    if(inter.object_hit != isx2.object_hit)
-        return true;
-    else
-        return false;
-
+    //Anything hit short of isx2 blocks it, including another part of the same object
+    return inter.t > 0 && inter.t < dist - 2e-3f;
 }
+
 glm::vec3 BidirectionalIntegrator::EvaluatePath(std::vector<PathNode> &eyePath, int nEye, std::vector<PathNode> &lightPath, int nLight)
 {
+    PathNode &pt = eyePath[nEye-1];
 
-    if (isBlocked(eyePath[nEye-1].isx, lightPath[nLight-1].isx))
-    {
-        return glm::vec3(0.f);
-    }
+    //The eye subpath found a light on its own
+    if(nLight == 0)
+        return pt.on_light ? pt.beta * Le(pt, pt.dirIn_world) : glm::vec3(0);
 
-    glm::vec3 L(1.0f);
-
-    // eyePath
-    for (int i = 0; i < nEye-1; ++i)
-    {
-        L *= eyePath[i].F * glm::abs(glm::dot(eyePath[i].dirOut_world, eyePath[i].isx.normal)) / (eyePath[i].pdf);
-    }
+    PathNode &qs = lightPath[nLight-1];
+    if(pt.on_light || !pt.connectable || !qs.connectable || (qs.on_light && nLight > 1))
+        return glm::vec3(0);
 
-    // connecting
-    L *= eyePath[nEye-1].F * G(eyePath[nEye-1], lightPath[nLight-1]) * lightPath[nLight-1].F;
+    glm::vec3 toLight = glm::normalize(qs.isx.point - pt.isx.point);
+    float pdf;
+    glm::vec3 f_pt = pt.isx.object_hit->material->EvaluateScatteredEnergy(pt.isx, pt.dirIn_local,
+                                                                          pt.isx.ToLocalNormalCoordinate(toLight), pdf);
+    glm::vec3 f_qs = nLight == 1 ? Le(qs, -toLight)
+                                 : qs.isx.object_hit->material->EvaluateScatteredEnergy(qs.isx, qs.dirIn_local,
+                                                                                        qs.isx.ToLocalNormalCoordinate(-toLight), pdf);
 
-    // lightPath
-    for (int i = nLight-2; i >= 0; --i)
-    {
-        L *= lightPath[i].F * glm::abs(glm::dot(lightPath[i].dirOut_world, lightPath[i].isx.normal)) / (lightPath[i].pdf);
-    }
+    glm::vec3 L = pt.beta * f_pt * G(pt, qs) * f_qs * qs.beta;
+    if(L.x == 0 && L.y == 0 && L.z == 0)
+        return L;
 
+    if (isBlocked(pt.isx, qs.isx))
+        return glm::vec3(0.f);
     return L;
 }
 
-glm::vec3 BidirectionalIntegrator::TraceRay(Ray r, unsigned int depth)
+glm::vec3 BidirectionalIntegrator::EvaluateCameraPath(std::vector<PathNode> &lightPath, int nLight, glm::vec2 &screen)
 {
-    Intersection isx = intersection_engine->GetIntersection(r);
-    if(isx.t < 0)
+    //A light seen directly is handled by the eye subpath alone
+    if(nLight < 2)
+        return glm::vec3(0);
+    PathNode &qs = lightPath[nLight-1];
+    if(qs.on_light || !qs.connectable || !scene->camera.WorldToScreen(qs.isx.point, screen))
         return glm::vec3(0);
-    else if(isx.object_hit->material->is_light_source)
-    {
-        return isx.object_hit->material->base_color * isx.texture_color;
-    }
 
-    glm::vec3 resultColor(0);
+    PathNode cam = CameraNode();
+    glm::vec3 toCamera = glm::normalize(cam.isx.point - qs.isx.point);
+    float pdf;
+    glm::vec3 f_qs = qs.isx.object_hit->material->EvaluateScatteredEnergy(qs.isx, qs.dirIn_local,
+                                                                          qs.isx.ToLocalNormalCoordinate(toCamera), pdf);
 
-    for(Geometry* light : scene->lights)
-    {
-        std::vector<PathNode> eyePath = generateEyePath(r);
-        std::vector<PathNode> lightPath = generateLightPath(light);
+    //Importance of a pinhole, normalized over the image plane
+    float cosTheta = glm::dot(-toCamera, cam.isx.normal);
+    float We = 1.0f / (scene->camera.ImagePlaneArea() * cosTheta * cosTheta * cosTheta * cosTheta);
 
-        if(!eyePath.empty() && !lightPath.empty())
-        {
-            PathNode* node = &lightPath[0];
-            float lightPdf = light->RayPDF(node->isx,Ray(node->isx.point,node->dirIn_world));
-            glm::vec3 Le(0);
-            if(lightPdf != 0)
-                Le = light->material->base_color * light->material->intensity / lightPdf;
-
-            glm::vec3 directWt(1.0f);
-            for(int i=1;i<=eyePath.size();i++)
-            {
-                node = &eyePath[i-1];
-
-                Ray ray(light->transform.position(), - node->dirIn_world);
-                resultColor += directWt * EstimateDirectLight(node->isx, ray, light) / WeightPath(i,0);
-                directWt *= node->F * glm::abs(glm::dot(node->dirOut_world,node->isx.normal)) / node->pdf;
-
-                for(int j=1;j<=lightPath.size();j++)
-                {
-                    resultColor += Le * EvaluatePath(eyePath,i,lightPath,j) / WeightPath(i,j);
-                }
-            }
-        }
-        else
-        {
-            continue;
-        }
+    glm::vec3 L = qs.beta * f_qs * G(qs, cam) * We;
+    if(L.x == 0 && L.y == 0 && L.z == 0)
+        return L;
 
-    }
-    return resultColor;
+    if(isBlocked(qs.isx, cam.isx))
+        return glm::vec3(0.f);
+    return L;
 }
 
-glm::vec3 BidirectionalIntegrator::EstimateDirectLight(Intersection &isx, Ray &ray, Geometry* &light)
+float BidirectionalIntegrator::MergeRatio(float pdfLight) const
 {
-    glm::vec3 Ld(0);
-
-    Ld = MIS_SampleBRDF(isx,ray,light) + MIS_SampleLight(isx,ray,light);
-
-    return Ld;
+    return 0;
 }
 
-float BidirectionalIntegrator::PowerHeuristic(const float &pdf_s, const float &n_s, const float &pdf_f, const float &n_f)
+float BidirectionalIntegrator::WeightPath(std::vector<PathNode> &eyePath, int nEye, std::vector<PathNode> &lightPath, int nLight)
 {
-    if(isinf(pdf_s))
-        return 1.0f;
-    if(isinf(pdf_f))
-        return 0.0f;
-    else if(fequal(pdf_f,0.0f) && fequal(pdf_s,0.0f))
-        return 0.f;
-    else
-        return glm::pow(pdf_s * n_s,2.0f) / (glm::pow(pdf_s * n_s,2.0f) + glm::pow(pdf_f * n_f,2.0f));
+    return 1.0f / StrategyRatioSum(eyePath, nEye, lightPath, nLight, NULL);
 }
 
-// MIS: sampling light source
-glm::vec3 BidirectionalIntegrator::MIS_SampleLight(Intersection &intersection, Ray &r, Geometry* &light)
+float BidirectionalIntegrator::StrategyRatioSum(std::vector<PathNode> &eyePath, int nEye, std::vector<PathNode> &lightPath, int nLight, float *mergeRatio)
 {
-    if(Number_Light == 0)
-        return glm::vec3(0);
-
-    // Direct light estimator: sample Light source
-    glm::vec3 sum_light_sample(0);
-    for(int i = 0; i < Number_Light; i++)
+    PathNode *pt = nEye > 0 ? &eyePath[nEye-1] : NULL;
+    PathNode *ptMinus = nEye > 1 ? &eyePath[nEye-2] : NULL;
+    PathNode *qs = nLight > 0 ? &lightPath[nLight-1] : NULL;
+    PathNode *qsMinus = nLight > 1 ? &lightPath[nLight-2] : NULL;
+
+    //The reverse densities of the four nodes next to the connection depend on the connection itself
+    float pdfRevPt = 0, pdfRevPtMinus = 0, pdfRevQs = 0, pdfRevQsMinus = 0;
+    if(pt == NULL)
     {
-        float u = uniform_distribution(generator);
-        float v = uniform_distribution(generator);
-
-        Intersection lightSample = light->SampleOnGeometrySurface(u, v, intersection.point + 1e-3f * intersection.normal);
-        //Intersection lightSample = light->RandomSampleOnSurface(u,v);
-        glm::vec3 wj = glm::normalize(lightSample.point - intersection.point);
-        glm::vec3 wo = - r.direction;
-        glm::vec3 P = intersection.point;
-        glm::vec3 N = intersection.normal;
+        PathNode cam = CameraNode();
+        pdfRevQs = ConvertDensity(CameraPdfDir(qs->isx.point - cam.isx.point), cam, *qs);
+        pdfRevQsMinus = PdfScatter(*qs, cam.isx.point - qs->isx.point, *qsMinus);
+    }
+    else if(qs != NULL)
+    {
+        pdfRevPt = nLight == 1 ? PdfEmit(*qs, *pt) : PdfScatter(*qs, qsMinus->isx.point - qs->isx.point, *pt);
+        pdfRevQs = PdfScatter(*pt, pt->dirIn_world, *qs);
+        if(ptMinus)
+            pdfRevPtMinus = PdfScatter(*pt, qs->isx.point - pt->isx.point, *ptMinus);
+        if(qsMinus)
+            pdfRevQsMinus = PdfScatter(*qs, pt->isx.point - qs->isx.point, *qsMinus);
+    }
+    else
+    {
+        pdfRevPt = PdfLightOrigin(*pt);
+        if(ptMinus)
+            pdfRevPtMinus = PdfEmit(*pt, *ptMinus);
+    }
 
-        float pdf_light = light->RayPDF(intersection, Ray(P + float(1e-3)*N, wj));
+    //pt scatters through its non-delta lobes, and so does qs unless this is a merge, which keeps qs's own bounce.
+    //A merged path that bounced specularly at qs cannot be connected at all.
+    bool qsDelta = mergeRatio != NULL && qs != NULL && qs->delta;
 
-        Intersection lightIntersection = intersection_engine->GetIntersection(Ray(P + float(1e-3)*N, wj));
-        float temp, pdf_brdf;
+    //Each step away from the connection hands one more node to the other subpath, multiplying the ratio by
+    //that node's pdfRev / pdfFwd. Past the nodes patched above, those products were summed into misSum
+    //when the subpaths were built.
+    float sum = qsDelta ? 0 : 1;
+    if(pt)
+    {
+        int lastEye = CameraConnectable() ? 0 : 1;
+        float inner = Connectable(eyePath, nEye-1, false) ? 1 : 0;
+        if(ptMinus)
+            inner += EyeNodeRatioSum(*ptMinus, pdfRevPtMinus, ptMinus->misSum, ptMinus->delta, nEye-2 >= lastEye);
+        sum += EyeNodeRatioSum(*pt, pdfRevPt, inner, false, nEye-1 >= lastEye);
+        if(mergeRatio != NULL && Mergeable(*pt, false))
+            *mergeRatio = MergeRatio(Remap0(pdfRevPt));
+    }
+    if(qs)
+    {
+        float inner = LightNodeTerms(lightPath, nLight-1, qsDelta);
+        if(qsMinus)
+            inner += RatioSquared(pdfRevQsMinus, qsMinus->pdfFwd) * qsMinus->misSum;
+        sum += RatioSquared(pdfRevQs, qs->pdfFwd) * inner;
+    }
+    return sum;
+}
 
-        glm::vec3 wo_local = intersection.ToLocalNormalCoordinate(wo);
-        glm::vec3 wj_local = intersection.ToLocalNormalCoordinate(wj);
+void BidirectionalIntegrator::SplatLightPath(std::vector<PathNode> &lightPath)
+{
+    //Light nodes seen by the camera land on whichever pixel they project to, not necessarily the one being traced
+    if(!CameraConnectable())
+        return;
+    for(int s = 2; s <= int(lightPath.size()); s++)
+    {
+        glm::vec2 screen;
+        glm::vec3 L = EvaluateCameraPath(lightPath, s, screen);
+        if(L.x != 0 || L.y != 0 || L.z != 0)
+            scene->film.AddSplat(screen, L * WeightPath(lightPath, 0, lightPath, s));
+    }
+}
 
-        glm::vec3 F = intersection.object_hit->material->EvaluateScatteredEnergy(intersection, wo_local, wj_local, pdf_brdf);
-        // reach light directly && pdf(wj) > 0
-        if(lightIntersection.t > 0 && lightIntersection.object_hit == light && pdf_light > 0 && pdf_brdf > 0)
+glm::vec3 BidirectionalIntegrator::ConnectSubpaths(std::vector<PathNode> &eyePath, std::vector<PathNode> &lightPath)
+{
+    //Paths are capped at max_depth nodes so every strategy for them fits in its subpath
+    glm::vec3 resultColor(0);
+    for(int t = 1; t <= int(eyePath.size()); t++)
+    {
+        for(int s = 0; s <= int(lightPath.size()) && s + t <= int(max_depth); s++)
         {
-
-            glm::vec3 Ld = light->material->EvaluateScatteredEnergy(lightSample, wo, -wj, temp);
-            float W = PowerHeuristic(pdf_light, float(Number_Light), pdf_brdf, float(Number_BRDF)); // cause shadow in center
-
-            sum_light_sample = sum_light_sample +
-                                  W * F * Ld * float(fabs(glm::dot(wj, N))) / pdf_light;
-
+            if(s == 0 && t == 1)
+                continue;
+            glm::vec3 L = EvaluatePath(eyePath, t, lightPath, s);
+            if(L.x != 0 || L.y != 0 || L.z != 0)
+                resultColor += L * WeightPath(eyePath, t, lightPath, s);
         }
     }
-    return sum_light_sample / float(Number_Light);
+    return resultColor;
 }
 
-// MIS: sampling BRDF
-glm::vec3 BidirectionalIntegrator::MIS_SampleBRDF(Intersection &intersection, Ray &r, Geometry* &light)
+glm::vec3 BidirectionalIntegrator::TraceRay(Ray r, unsigned int depth)
 {
-    if(Number_BRDF == 0)
+    //The light path starts on one light chosen by power
+    std::vector<PathNode> lightPath;
+    float selectPdf;
+    Geometry* light = scene->light_sampler.Sample(Get1D(), selectPdf);
+    if(light != NULL && selectPdf > 0)
+        lightPath = generateLightPath(light, selectPdf);
+    SplatLightPath(lightPath);
+
+    std::vector<PathNode> eyePath = generateEyePath(r);
+    if(eyePath.empty())
         return glm::vec3(0);
-
-    // Direct light estimator: sample BRDF
-    glm::vec3 sum_brdf_sample(0.0f);
-    for(int i = 0; i < Number_BRDF; i++)
+    else if(eyePath[0].on_light)
     {
-        glm::vec3 wo_local = intersection.ToLocalNormalCoordinate(-r.direction);
-        glm::vec3 wj_local;
-        float pdf_brdf;
-        glm::vec3 F = intersection.object_hit->material->SampleAndEvaluateScatteredEnergy(intersection,wo_local,wj_local,pdf_brdf);
-
-        glm::vec3 wj_world = intersection.ToWorldNormalCoordinate(wj_local);
-        glm::vec3 wo_world = - r.direction;
-
-        Intersection isxOnLight = intersection_engine->GetIntersection(Ray(intersection.point+float(1e-3)*intersection.normal, wj_world));
-
-        if(isxOnLight.t > 0 && isxOnLight.object_hit == light && pdf_brdf > 0)
-        {
-            float temp,pdf_light = light->RayPDF(intersection, Ray(intersection.point, wj_world));
-            float W = PowerHeuristic(pdf_brdf,float(Number_BRDF),pdf_light,float(Number_Light));
-            glm::vec3 Ld = light->material->EvaluateScatteredEnergy(isxOnLight,wo_world,-wj_world,temp);
-
-            if(pdf_light > 0 )
-            {
-                if(isinf(pdf_brdf)) // delta specular surface
-                {
-                    sum_brdf_sample = sum_brdf_sample +
-                            F * Ld * float(fabs(glm::dot(wj_world, intersection.normal))) / pdf_light;
-                }
-                else
-                {
-                    sum_brdf_sample = sum_brdf_sample +
-                            W * F * Ld * float(fabs(glm::dot(wj_world,intersection.normal))) / pdf_brdf;
-                }
-            }
-        }
-
+        return eyePath[0].isx.object_hit->material->base_color * eyePath[0].isx.texture_color;
     }
-    return sum_brdf_sample / float(Number_BRDF);
+    return ConnectSubpaths(eyePath, lightPath);
 }
-
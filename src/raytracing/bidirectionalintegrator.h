@@ -10,32 +10,86 @@ struct PathNode
     glm::vec3 dirIn_world,dirOut_world;
     glm::vec3 dirIn_local,dirOut_local;
     glm::vec3 F;//base color and texture color all included here
-    float pdf;
+    float pdf;//solid angle pdf of dirOut
+
+    glm::vec3 beta;//throughput of the subpath up to this node, not including this node's own F
+    float pdfFwd;//area density of reaching this node from the node before it on its own subpath
+    float pdfRev;//area density of reaching this node the other way, from the node after it
+    bool delta;//dirOut was sampled from a specular lobe, so the subpath scatters through a delta here
+    bool connectable;//the material has a non-delta lobe, so a connection or merge can end here whatever lobe dirOut came from
+    bool on_light;//the node lies on an emitter
+    float misSum;//squared pdf ratios of the strategies that split the subpath at or before this node, see StrategyRatioSum
 };
 
+//Bidirectional path tracer. Each sample builds one eye subpath and one light subpath, every node keeping
+//its cumulative throughput, then evaluates every (light nodes s, eye nodes t) connection in O(1)
+//and weights it with the power heuristic over all strategies that could have produced the same path.
+//Subclasses that add merging strategies (VCM) report their densities through MergeRatio.
+//With a pinhole camera, light nodes are also connected straight to the eye (t = 0) and splatted into the scene's film.
 class BidirectionalIntegrator: public Integrator
 {
 public:
     BidirectionalIntegrator();
 
     virtual glm::vec3 TraceRay(Ray r, unsigned int depth);
-    std::vector<PathNode> generateLightPath(Geometry* &light);
+    std::vector<PathNode> generateLightPath(Geometry* &light, float selectPdf);
     std::vector<PathNode> generateEyePath(Ray r);
 
+    //Unweighted contribution of the path made of the first nEye eye nodes and the first nLight light nodes
     glm::vec3 EvaluatePath(std::vector<PathNode>& eyePath,int nEye,std::vector<PathNode>& lightPath,int nLight);
+    //Unweighted contribution of the first nLight light nodes seen directly by the camera, and the screen point it lands on
+    glm::vec3 EvaluateCameraPath(std::vector<PathNode>& lightPath,int nLight,glm::vec2 &screen);
+    //Power heuristic weight of that connection against every other (s, t) split of the same path. nEye may be 0.
+    float WeightPath(std::vector<PathNode>& eyePath,int nEye,std::vector<PathNode>& lightPath,int nLight);
+    //Sum over every strategy that could have produced the path of (its pdf / this connection's pdf)^2, the connection included.
+    //The connection scatters through the non-delta lobes of both its ends, whatever lobes the subpaths sampled there.
+    //mergeRatio, if not NULL, asks for the path merged at the last eye node instead, which keeps the light subpath's own
+    //lobe at its last node, and receives the pdf of that merge over this connection's pdf.
+    //Only the two nodes on each side of the connection are visited; the rest comes from their misSum.
+    float StrategyRatioSum(std::vector<PathNode>& eyePath,int nEye,std::vector<PathNode>& lightPath,int nLight,float *mergeRatio);
 
     float G(PathNode& a,PathNode& b);
-
-    float WeightPath(int eyeL,int lightL) {return float(eyeL+lightL);}
     bool isBlocked(const Intersection& isx1,const Intersection & isx2);
 
-    glm::vec3 EstimateDirectLight(Intersection& isx,Ray& r,Geometry*& light);
-    glm::vec3 MIS_SampleLight(Intersection&, Ray&, Geometry* &);
-    glm::vec3 MIS_SampleBRDF(Intersection&, Ray&, Geometry *&);
+protected:
+    //Pdf of merging at a node over the pdf of connecting with that node as the last eye node,
+    //given the area density pdfLight of the light subpath reaching it. Plain BDPT cannot merge.
+    virtual float MergeRatio(float pdfLight) const;
+
+    //Splats every camera connection of lightPath into the scene's film
+    void SplatLightPath(std::vector<PathNode>& lightPath);
+    //Weighted sum of every connection between the two subpaths that has at least one eye node
+    glm::vec3 ConnectSubpaths(std::vector<PathNode>& eyePath,std::vector<PathNode>& lightPath);
 
-    float PowerHeuristic(const float &pdf_s, const float &n_s, const float &pdf_f, const float &n_f);
+    //Extends path from r until it leaves the scene, hits a light or holds maxNodes nodes
+    void RandomWalk(Ray r, glm::vec3 beta, float pdfDir, std::vector<PathNode> &path, int maxNodes);
+    //Fills in misSum along a finished subpath, once its densities are all known
+    void AccumulateEyeRatios(std::vector<PathNode> &eyePath);
+    void AccumulateLightRatios(std::vector<PathNode> &lightPath);
+    //Terms the eye node v adds to a ratio sum: merging at v, then handing v and the sum inner past it to the light subpath.
+    //pdfRev is the light subpath's density of reaching v; v can only be handed over if movable.
+    float EyeNodeRatioSum(const PathNode &v, float pdfRev, float inner, bool delta, bool movable) const;
+    //Terms light node i adds on its own, given whether the path scatters through a delta there:
+    //connecting just before it, and merging at it
+    float LightNodeTerms(const std::vector<PathNode> &lightPath, int i, bool delta) const;
 
+    //Converts a solid angle pdf at from into an area density at to
+    static float ConvertDensity(float pdf, const PathNode &from, const PathNode &to);
+    //Area density at next of v scattering light that arrives from wo_world toward next
+    float PdfScatter(const PathNode &v, const glm::vec3 &wo_world, const PathNode &next);
+    //Area density at next of the light node v emitting toward next
+    float PdfEmit(const PathNode &v, const PathNode &next);
+    //Area density of the light sampler choosing v's light and the point on it
+    float PdfLightOrigin(const PathNode &v);
+
+    glm::vec3 Le(const PathNode &v, const glm::vec3 &w_world);
+
+    //Light paths can only be connected to a pinhole; a lens would need its own sampled point
+    bool CameraConnectable() const;
+    //The eye as a path node, facing down LOOK, so G and ConvertDensity apply to it
+    PathNode CameraNode() const;
+    //Solid angle density of the camera tracing a ray toward w_world
+    float CameraPdfDir(const glm::vec3 &w_world) const;
 };
 
 #endif // BIDIRECTIONALINTEGRATOR
-
@@ -0,0 +1,291 @@
+#include <raytracing/denoiser.h>
+#include <scene/materials/bxdfs/bxdfsimd.h>
+#include <QThread>
+
+//B3-spline weights of the kernel's taps at offsets -2..2
+static const float kernel[5] = {1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16};
+
+static inline float Luminance(float r, float g, float b)
+{
+    return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+//Runs one iteration over a band of rows
+class DenoiseThread : public QThread
+{
+public:
+    DenoiseThread(const Denoiser *d, const Denoiser::Planes *p, const std::vector<float> *i, std::vector<float> *o,
+                  int s, int start, int end)
+        : denoiser(d), planes(p), in(i), out(o), step(s), y0(start), y1(end){}
+protected:
+    virtual void run() {denoiser->Pass(*planes, in, out, step, y0, y1);}
+    const Denoiser *denoiser;
+    const Denoiser::Planes *planes;
+    const std::vector<float> *in;
+    std::vector<float> *out;
+    int step;
+    int y0, y1;
+};
+
+Denoiser::Denoiser() : iterations(4), sigma_color(4.0f), sigma_normal(64.0f), sigma_depth(0.1f), sigma_albedo(0.1f), thread_count(0)
+{}
+
+void Denoiser::FilterPixel(const Planes &p, const std::vector<float> *in, std::vector<float> *out, int x, int y, int step, float inv_a) const
+{
+    int w = p.width, h = p.height;
+    int c = y * w + x;
+    float cr = in[0][c], cg = in[1][c], cb = in[2][c];
+    float l = Luminance(cr, cg, cb);
+    float inv_l = 1.0f / (sigma_color * glm::sqrt(glm::max(in[3][c], 0.0f)) + 1e-4f);
+    float nx = p.normal[0][c], ny = p.normal[1][c], nz = p.normal[2][c];
+    float ar = p.albedo[0][c], ag = p.albedo[1][c], ab = p.albedo[2][c];
+    float z = p.depth[c];
+    bool hit = p.hit[c] > 0;
+    float inv_z = 1.0f / (sigma_depth * step * glm::max(z, 1e-3f));
+
+    float sum_r = 0, sum_g = 0, sum_b = 0, sum_v = 0, sum_w = 0;
+    for(int dy = -2; dy <= 2; dy++)
+    {
+        int qy = glm::clamp(y + dy * step, 0, h - 1);
+        for(int dx = -2; dx <= 2; dx++)
+        {
+            int q = qy * w + glm::clamp(x + dx * step, 0, w - 1);
+            float da_r = p.albedo[0][q] - ar, da_g = p.albedo[1][q] - ag, da_b = p.albedo[2][q] - ab;
+            float e = glm::abs(Luminance(in[0][q], in[1][q], in[2][q]) - l) * inv_l
+                    + (da_r*da_r + da_g*da_g + da_b*da_b) * inv_a
+                    + glm::abs(p.depth[q] - z) * inv_z * glm::max(glm::abs(dx), glm::abs(dy));
+            float wn;
+            if(hit != (p.hit[q] > 0))
+                wn = 0;
+            else if(!hit)
+                wn = 1;
+            else
+            {
+                float cos_n = nx * p.normal[0][q] + ny * p.normal[1][q] + nz * p.normal[2][q];
+                wn = cos_n > 0 ? glm::pow(cos_n, sigma_normal) : 0.0f;
+            }
+            float wgt = kernel[dx + 2] * kernel[dy + 2] * wn * glm::exp(-e);
+            sum_r += wgt * in[0][q];
+            sum_g += wgt * in[1][q];
+            sum_b += wgt * in[2][q];
+            sum_v += wgt * wgt * in[3][q];
+            sum_w += wgt;
+        }
+    }
+    //The center tap always has weight, unless its normal was averaged to nothing
+    if(sum_w > 0)
+    {
+        out[0][c] = sum_r / sum_w;
+        out[1][c] = sum_g / sum_w;
+        out[2][c] = sum_b / sum_w;
+        out[3][c] = sum_v / (sum_w * sum_w);
+    }
+    else
+    {
+        for(int k = 0; k < 4; k++)
+            out[k][c] = in[k][c];
+    }
+}
+
+void Denoiser::Pass(const Planes &p, const std::vector<float> *in, std::vector<float> *out, int step, int y0, int y1) const
+{
+    int w = p.width, h = p.height;
+    float inv_a = 1.0f / (sigma_albedo * sigma_albedo);
+
+    //Pixels whose taps all fall inside the row can be done four at a time without clamping
+    int x_begin = glm::min(2 * step, w);
+    int x_end = glm::max(w - 2 * step, x_begin);
+
+    for(int y = y0; y < y1; y++)
+    {
+        int x = 0;
+        for(; x < x_begin; x++)
+            FilterPixel(p, in, out, x, y, step, inv_a);
+
+#if defined(__SSE2__)
+        using namespace bxdfsimd;
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 lr = _mm_set1_ps(0.2126f), lg = _mm_set1_ps(0.7152f), lb = _mm_set1_ps(0.0722f);
+        for(; x + 4 <= x_end; x += 4)
+        {
+            int c = y * w + x;
+            __m128 cr = _mm_loadu_ps(&in[0][c]), cg = _mm_loadu_ps(&in[1][c]), cb = _mm_loadu_ps(&in[2][c]), cv = _mm_loadu_ps(&in[3][c]);
+            __m128 l = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lr, cr), _mm_mul_ps(lg, cg)), _mm_mul_ps(lb, cb));
+            __m128 inv_l = _mm_div_ps(one, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(sigma_color), _mm_sqrt_ps(_mm_max_ps(cv, zero))), _mm_set1_ps(1e-4f)));
+            __m128 nx = _mm_loadu_ps(&p.normal[0][c]), ny = _mm_loadu_ps(&p.normal[1][c]), nz = _mm_loadu_ps(&p.normal[2][c]);
+            __m128 ar = _mm_loadu_ps(&p.albedo[0][c]), ag = _mm_loadu_ps(&p.albedo[1][c]), ab = _mm_loadu_ps(&p.albedo[2][c]);
+            __m128 z = _mm_loadu_ps(&p.depth[c]);
+            __m128 hit = _mm_cmpgt_ps(_mm_loadu_ps(&p.hit[c]), zero);
+            __m128 inv_z = _mm_div_ps(one, _mm_mul_ps(_mm_set1_ps(sigma_depth * step), _mm_max_ps(z, _mm_set1_ps(1e-3f))));
+
+            __m128 sum_r = zero, sum_g = zero, sum_b = zero, sum_v = zero, sum_w = zero;
+            for(int dy = -2; dy <= 2; dy++)
+            {
+                int row = glm::clamp(y + dy * step, 0, h - 1) * w;
+                for(int dx = -2; dx <= 2; dx++)
+                {
+                    int q = row + x + dx * step;
+                    __m128 qr = _mm_loadu_ps(&in[0][q]), qg = _mm_loadu_ps(&in[1][q]), qb = _mm_loadu_ps(&in[2][q]);
+                    __m128 ql = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lr, qr), _mm_mul_ps(lg, qg)), _mm_mul_ps(lb, qb));
+                    __m128 da_r = _mm_sub_ps(_mm_loadu_ps(&p.albedo[0][q]), ar);
+                    __m128 da_g = _mm_sub_ps(_mm_loadu_ps(&p.albedo[1][q]), ag);
+                    __m128 da_b = _mm_sub_ps(_mm_loadu_ps(&p.albedo[2][q]), ab);
+                    __m128 e = _mm_mul_ps(Abs(_mm_sub_ps(ql, l)), inv_l);
+                    e = _mm_add_ps(e, _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(da_r, da_r), _mm_mul_ps(da_g, da_g)), _mm_mul_ps(da_b, da_b)), _mm_set1_ps(inv_a)));
+                    __m128 dz = Abs(_mm_sub_ps(_mm_loadu_ps(&p.depth[q]), z));
+                    e = _mm_add_ps(e, _mm_mul_ps(_mm_mul_ps(dz, inv_z), _mm_set1_ps(float(glm::max(glm::abs(dx), glm::abs(dy))))));
+
+                    //Normal weight: 0 between a hit and a miss, 1 between two misses
+                    __m128 cos_n = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_loadu_ps(&p.normal[0][q])),
+                                                         _mm_mul_ps(ny, _mm_loadu_ps(&p.normal[1][q]))),
+                                                         _mm_mul_ps(nz, _mm_loadu_ps(&p.normal[2][q])));
+                    __m128 q_hit = _mm_cmpgt_ps(_mm_loadu_ps(&p.hit[q]), zero);
+                    __m128 wn = Pow(cos_n, _mm_set1_ps(sigma_normal));
+                    wn = Select(_mm_and_ps(hit, q_hit), wn, Select(_mm_or_ps(hit, q_hit), zero, one));
+
+                    __m128 wgt = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(kernel[dx + 2] * kernel[dy + 2]), wn), Exp(_mm_sub_ps(zero, e)));
+                    sum_r = _mm_add_ps(sum_r, _mm_mul_ps(wgt, qr));
+                    sum_g = _mm_add_ps(sum_g, _mm_mul_ps(wgt, qg));
+                    sum_b = _mm_add_ps(sum_b, _mm_mul_ps(wgt, qb));
+                    sum_v = _mm_add_ps(sum_v, _mm_mul_ps(_mm_mul_ps(wgt, wgt), _mm_loadu_ps(&in[3][q])));
+                    sum_w = _mm_add_ps(sum_w, wgt);
+                }
+            }
+            __m128 valid = _mm_cmpgt_ps(sum_w, zero);
+            __m128 inv_w = _mm_div_ps(one, Select(valid, sum_w, one));
+            _mm_storeu_ps(&out[0][c], Select(valid, _mm_mul_ps(sum_r, inv_w), cr));
+            _mm_storeu_ps(&out[1][c], Select(valid, _mm_mul_ps(sum_g, inv_w), cg));
+            _mm_storeu_ps(&out[2][c], Select(valid, _mm_mul_ps(sum_b, inv_w), cb));
+            _mm_storeu_ps(&out[3][c], Select(valid, _mm_mul_ps(sum_v, _mm_mul_ps(inv_w, inv_w)), cv));
+        }
+#endif
+        for(; x < w; x++)
+            FilterPixel(p, in, out, x, y, step, inv_a);
+    }
+}
+
+void Denoiser::Run(Film &film) const
+{
+    if(!film.AOVsEnabled() || film.width == 0 || film.height == 0)
+        return;
+
+    Planes p;
+    p.width = film.width;
+    p.height = film.height;
+    int w = film.width, h = film.height;
+    unsigned int n = film.width * film.height;
+    for(int k = 0; k < 3; k++)
+    {
+        p.normal[k].resize(n);
+        p.albedo[k].resize(n);
+    }
+    for(int k = 0; k < 4; k++)
+    {
+        p.color[k].resize(n);
+        p.scratch[k].resize(n);
+    }
+    p.depth.resize(n);
+    p.hit.resize(n);
+
+    //Demodulate: filter the lighting, not the albedo it was multiplied by
+    const float min_albedo = 1e-3f;
+    for(unsigned int i = 0; i < n; i++)
+    {
+        const AOVSample &a = film.aovs[i];
+        glm::vec3 normal = glm::length2(a.normal) > 1e-6f ? glm::normalize(a.normal) : glm::vec3(0);
+        for(int k = 0; k < 3; k++)
+        {
+            p.normal[k][i] = normal[k];
+            p.albedo[k][i] = a.albedo[k];
+            p.color[k][i] = film.pixels[i][k] / glm::max(a.albedo[k], min_albedo);
+        }
+        p.depth[i] = a.depth;
+        p.hit[i] = a.object_id >= 0 ? 1.0f : 0.0f;
+    }
+
+    //Each pixel's variance comes from the spread of its samples, demodulated like its color. With one sample per pixel
+    //there is no spread, and it is estimated from the luminance of the 5x5 neighborhood instead,
+    //counting only neighbors on the same side of a hit/miss boundary.
+    bool has_variance = false;
+    for(unsigned int i = 0; i < n && !has_variance; i++)
+        has_variance = film.aovs[i].variance > 0;
+    for(unsigned int i = 0; i < n && has_variance; i++)
+    {
+        float a = glm::max(Luminance(p.albedo[0][i], p.albedo[1][i], p.albedo[2][i]), min_albedo);
+        p.color[3][i] = film.aovs[i].variance / (a * a);
+    }
+    for(int y = 0; y < h && !has_variance; y++)
+    {
+        for(int x = 0; x < w; x++)
+        {
+            int c = y * w + x;
+            float sum = 0, sum2 = 0, count = 0;
+            for(int qy = glm::max(y - 2, 0); qy <= glm::min(y + 2, h - 1); qy++)
+            {
+                for(int qx = glm::max(x - 2, 0); qx <= glm::min(x + 2, w - 1); qx++)
+                {
+                    int q = qy * w + qx;
+                    if(p.hit[q] != p.hit[c])
+                        continue;
+                    float l = Luminance(p.color[0][q], p.color[1][q], p.color[2][q]);
+                    sum += l;
+                    sum2 += l * l;
+                    count++;
+                }
+            }
+            p.color[3][c] = glm::max(sum2 / count - (sum / count) * (sum / count), 0.0f);
+        }
+    }
+
+    //Variance estimates from a handful of samples are noisy themselves, so they are smoothed with a 3x3 Gaussian
+    std::vector<float> &variance = p.scratch[3];
+    for(int y = 0; y < h; y++)
+    {
+        for(int x = 0; x < w; x++)
+        {
+            float sum = 0, sum_w = 0;
+            for(int dy = -1; dy <= 1; dy++)
+            {
+                for(int dx = -1; dx <= 1; dx++)
+                {
+                    int qx = x + dx, qy = y + dy;
+                    if(qx < 0 || qy < 0 || qx >= w || qy >= h)
+                        continue;
+                    float k = (dx == 0 ? 2.0f : 1.0f) * (dy == 0 ? 2.0f : 1.0f);
+                    sum += k * p.color[3][qy * w + qx];
+                    sum_w += k;
+                }
+            }
+            variance[y * w + x] = sum / sum_w;
+        }
+    }
+    p.color[3].swap(variance);
+
+    unsigned int threads = thread_count > 0 ? thread_count : glm::max(QThread::idealThreadCount(), 1);
+    threads = glm::min(threads, film.height);
+    std::vector<float> *in = p.color, *out = p.scratch;
+    for(int i = 0; i < iterations; i++)
+    {
+        int step = 1 << i;
+        //Every band but the last runs on its own thread; this one takes the last
+        std::vector<DenoiseThread*> workers;
+        unsigned int band = (film.height + threads - 1) / threads;
+        for(unsigned int t = 0; t + 1 < threads; t++)
+        {
+            workers.push_back(new DenoiseThread(this, &p, in, out, step, t * band, glm::min((t + 1) * band, film.height)));
+            workers.back()->start();
+        }
+        Pass(p, in, out, step, glm::min((threads - 1) * band, film.height), film.height);
+        for(DenoiseThread* worker : workers)
+        {
+            worker->wait();
+            delete worker;
+        }
+        std::swap(in, out);
+    }
+
+    for(unsigned int i = 0; i < n; i++)
+        for(int k = 0; k < 3; k++)
+            film.pixels[i][k] = in[k][i] * glm::max(film.aovs[i].albedo[k], min_albedo);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <la.h>
+#include <raytracing/film.h>
+#include <vector>
+
+//Post-process denoiser: an edge-avoiding a-trous wavelet filter (Dammertz et al. 2010) guided by the film's AOVs.
+//Radiance is divided by the first-hit albedo before filtering and multiplied back after, so texture detail
+//is kept and only the lighting is smoothed. Each iteration is a 5x5 B3-spline kernel whose taps are spread
+//step = 2^i pixels apart, with every tap's weight cut down by its difference to the center pixel in
+//color, normal, depth and albedo. As in SVGF, color differences are measured in luminance against the center's
+//standard deviation, estimated from its samples and carried through the iterations, so noisy regions are
+//smoothed harder than clean ones. Rows are split over threads and four pixels are weighted at once with SSE.
+class Denoiser
+{
+public:
+    Denoiser();
+
+    //Replaces film's pixels with the denoised image. Films without AOVs are left alone.
+    void Run(Film &film) const;
+
+    int iterations;//Each one doubles the kernel's reach, 4 gives a 61 pixel footprint
+    float sigma_color;//How many standard deviations of luminance a tap can differ by before it is ignored
+    float sigma_normal;//Exponent on the cosine between normals
+    float sigma_depth;//Depth differences relative to the center's depth, per pixel of tap distance
+    float sigma_albedo;
+    unsigned int thread_count;//0 for QThread::idealThreadCount()
+
+    //Guide and color planes, one float per pixel each
+    struct Planes
+    {
+        int width, height;
+        std::vector<float> normal[3], depth, albedo[3], hit;
+        //R, G, B and the luminance variance
+        std::vector<float> color[4], scratch[4];
+    };
+
+    //One iteration over rows [y0, y1) from in to out
+    void Pass(const Planes &planes, const std::vector<float> *in, std::vector<float> *out, int step, int y0, int y1) const;
+
+private:
+    //The weighted sum over the 25 taps for pixel (x, y), taps' x clamped to the image
+    void FilterPixel(const Planes &planes, const std::vector<float> *in, std::vector<float> *out, int x, int y, int step, float inv_a) const;
+};
@@ -1,5 +1,57 @@
 #include <raytracing/film.h>
+#include <raytracing/filters/filter.h>
+#include <raytracing/hdrwriter.h>
 #include <bmp/EasyBMP.h>
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+FilmTile::FilmTile() : x0(0), y0(0), x1(0), y1(0){}
+
+void FilmTile::Reset(int x0, int y0, int x1, int y1)
+{
+    this->x0 = x0;
+    this->y0 = y0;
+    this->x1 = x1;
+    this->y1 = y1;
+    sums.assign(glm::max(0, x1 - x0) * glm::max(0, y1 - y0), glm::vec4(0));
+}
+
+void FilmTile::AddSample(const glm::vec2 &screen, const glm::vec3 &color, const Filter &filter)
+{
+    //Offsets are measured from pixel centers
+    glm::vec2 p = screen - glm::vec2(0.5f);
+    float r = filter.Radius();
+    int px0 = glm::max(int(glm::ceil(p.x - r)), x0);
+    int px1 = glm::min(int(glm::floor(p.x + r)) + 1, x1);
+    int py0 = glm::max(int(glm::ceil(p.y - r)), y0);
+    int py1 = glm::min(int(glm::floor(p.y + r)) + 1, y1);
+    if(px0 >= px1 || py0 >= py1)
+        return;
+
+    //The filter is separable, so each column and row weight is looked up once
+    float wx[2 * Filter::max_radius + 1];
+    for(int x = px0; x < px1; x++)
+        wx[x - px0] = filter.Lookup(x - p.x);
+    for(int y = py0; y < py1; y++)
+    {
+        float wy = filter.Lookup(y - p.y);
+        glm::vec4 *row = &sums[(y - y0) * (x1 - x0)];
+        for(int x = px0; x < px1; x++)
+        {
+            float w = wx[x - px0] * wy;
+            row[x - x0] += glm::vec4(color * w, w);
+        }
+    }
+}
+
+glm::vec3 FilmTile::Resolve(int x, int y) const
+{
+    const glm::vec4 &s = Sum(x, y);
+    //Negative filter lobes can leave a pixel below zero
+    return s.w != 0 ? glm::max(glm::vec3(s) / s.w, glm::vec3(0)) : glm::vec3(0);
+}
 
 Film::Film() : Film(400, 400){}
 
@@ -8,19 +60,291 @@ Film::Film(unsigned int width, unsigned int height)
     SetDimensions(width, height);
 }
 
+Film::Film(const Film &f)
+{
+    *this = f;
+}
+
+Film& Film::operator=(const Film &f)
+{
+    if(this != &f)
+    {
+        SetDimensions(f.width, f.height);
+        pixels = f.pixels;
+        aovs = f.aovs;
+        sample_counts = f.sample_counts;
+    }
+    return *this;
+}
+
 void Film::SetDimensions(unsigned int w, unsigned int h)
 {
     this->width = w;
     this->height = h;
-    pixels.clear();
-    pixels = std::vector<std::vector<glm::vec3>>(width);
-    for(unsigned int i = 0; i < width; i++){
-        pixels[i] = std::vector<glm::vec3>(height);
+    pixels.assign(width * height, glm::vec3(0));
+    sample_counts.assign(width * height, 0);
+    EnableAOVs(AOVsEnabled());
+    splats.reset(new std::atomic<float>[3 * width * height]);
+    splat_marks.reset(new std::atomic<bool>[width * height]);
+    splat_pixels.reset(new unsigned int[width * height]);
+    tile_sums.reset(new std::atomic<float>[4 * width * height]);
+    //ClearSplats only resets marked pixels, so the new buffers start out zeroed everywhere
+    for(unsigned int i = 0; i < 3 * width * height; i++)
+        splats[i].store(0.0f, std::memory_order_relaxed);
+    for(unsigned int i = 0; i < width * height; i++)
+        splat_marks[i].store(false, std::memory_order_relaxed);
+    splat_pixel_count.store(0, std::memory_order_relaxed);
+    ClearTiles();
+}
+
+void Film::EnableAOVs(bool enable)
+{
+    aovs.clear();
+    if(enable)
+        aovs.resize(width * height);
+}
+
+void Film::AtomicAdd(std::atomic<float> &a, float v)
+{
+    float old = a.load(std::memory_order_relaxed);
+    while(!a.compare_exchange_weak(old, old + v, std::memory_order_relaxed))
+        ;
+}
+
+void Film::AddSplat(const glm::vec2 &screen, const glm::vec3 &color)
+{
+    int x = int(screen.x);
+    int y = int(screen.y);
+    if(x < 0 || y < 0 || x >= int(width) || y >= int(height))
+        return;
+    MarkSplat(y * width + x);
+    std::atomic<float> *s = &splats[3 * (y * width + x)];
+    AtomicAdd(s[0], color.r);
+    AtomicAdd(s[1], color.g);
+    AtomicAdd(s[2], color.b);
+}
+
+void Film::MarkSplat(unsigned int index)
+{
+    //The thread that sets the mark is the only one to list the pixel
+    if(!splat_marks[index].exchange(true, std::memory_order_relaxed))
+        splat_pixels[splat_pixel_count.fetch_add(1, std::memory_order_relaxed)] = index;
+}
+
+void Film::MergeSplats(float scale)
+{
+    for(unsigned int j = 0; j < height; j++) {
+        for(unsigned int i = 0; i < width; i++) {
+            std::atomic<float> *s = &splats[3 * (j * width + i)];
+            Pixel(i, j) += scale * glm::vec3(s[0].load(), s[1].load(), s[2].load());
+        }
+    }
+}
+
+void Film::GetSplats(std::vector<unsigned int> &indices, std::vector<glm::vec3> &colors) const
+{
+    indices.clear();
+    colors.clear();
+    unsigned int count = splat_pixel_count.load(std::memory_order_relaxed);
+    for(unsigned int p = 0; p < count; p++)
+    {
+        unsigned int i = splat_pixels[p];
+        glm::vec3 c(splats[3 * i].load(std::memory_order_relaxed), splats[3 * i + 1].load(std::memory_order_relaxed),
+                    splats[3 * i + 2].load(std::memory_order_relaxed));
+        if(c.x != 0 || c.y != 0 || c.z != 0)
+        {
+            indices.push_back(i);
+            colors.push_back(c);
+        }
+    }
+}
+
+void Film::ClearSplats()
+{
+    unsigned int count = splat_pixel_count.load(std::memory_order_relaxed);
+    for(unsigned int p = 0; p < count; p++)
+    {
+        unsigned int i = splat_pixels[p];
+        splats[3 * i].store(0.0f, std::memory_order_relaxed);
+        splats[3 * i + 1].store(0.0f, std::memory_order_relaxed);
+        splats[3 * i + 2].store(0.0f, std::memory_order_relaxed);
+        splat_marks[i].store(false, std::memory_order_relaxed);
+    }
+    splat_pixel_count.store(0, std::memory_order_relaxed);
+}
+
+void Film::MergeTile(const FilmTile &tile)
+{
+    int tx0 = glm::max(tile.x0, 0), tx1 = glm::min(tile.x1, int(width));
+    int ty0 = glm::max(tile.y0, 0), ty1 = glm::min(tile.y1, int(height));
+    for(int y = ty0; y < ty1; y++) {
+        for(int x = tx0; x < tx1; x++) {
+            const glm::vec4 &s = tile.sums[(y - tile.y0) * (tile.x1 - tile.x0) + x - tile.x0];
+            if(s.w == 0 && s.x == 0 && s.y == 0 && s.z == 0)
+                continue;
+            std::atomic<float> *t = &tile_sums[4 * (y * width + x)];
+            AtomicAdd(t[0], s.x);
+            AtomicAdd(t[1], s.y);
+            AtomicAdd(t[2], s.z);
+            AtomicAdd(t[3], s.w);
+        }
+    }
+}
+
+void Film::ResolveTiles()
+{
+    for(unsigned int j = 0; j < height; j++) {
+        for(unsigned int i = 0; i < width; i++) {
+            std::atomic<float> *t = &tile_sums[4 * (j * width + i)];
+            float w = t[3].load();
+            glm::vec3 sum(t[0].load(), t[1].load(), t[2].load());
+            Pixel(i, j) = w != 0 ? glm::max(sum / w, glm::vec3(0)) : glm::vec3(0);
+        }
+    }
+}
+
+void Film::ClearTiles()
+{
+    for(unsigned int i = 0; i < 4 * width * height; i++)
+        tile_sums[i].store(0.0f, std::memory_order_relaxed);
+}
+
+void Film::ClearTiles(int x0, int y0, int x1, int y1)
+{
+    x0 = glm::max(x0, 0);
+    y0 = glm::max(y0, 0);
+    x1 = glm::min(x1, int(width));
+    y1 = glm::min(y1, int(height));
+    for(int y = y0; y < y1; y++)
+    {
+        std::atomic<float> *row = &tile_sums[4 * (y * width + x0)];
+        for(int i = 0; i < 4 * (x1 - x0); i++)
+            row[i].store(0.0f, std::memory_order_relaxed);
     }
 }
 
+glm::vec4 Film::Accumulated(unsigned int x, unsigned int y) const
+{
+    const std::atomic<float> *t = &tile_sums[4 * (y * width + x)];
+    return glm::vec4(t[0].load(std::memory_order_relaxed), t[1].load(std::memory_order_relaxed),
+                     t[2].load(std::memory_order_relaxed), t[3].load(std::memory_order_relaxed));
+}
+
+void Film::ClearAccumulation()
+{
+    ClearSplats();
+    ClearTiles();
+    sample_counts.assign(width * height, 0);
+    EnableAOVs(AOVsEnabled());
+}
+
+namespace
+{
+const char checkpoint_magic[8] = {'2', '7', '7', 'C', 'K', 'P', 'T', '1'};
+
+//Fixed-size header, followed by width * height (RGB * weight, weight) float quadruples, sample counts,
+//RGB splat float triples and, if has_aovs, AOVSamples, each block row by row in the film's own layout
+struct CheckpointHeader
+{
+    char magic[8];
+    unsigned int width, height;
+    unsigned int seed;
+    char sampler[16];
+    unsigned int has_aovs;
+    unsigned int aov_size;//sizeof(AOVSample) of the build that wrote it, since the struct is stored as it is in memory
+};
+}
+
+bool Film::WriteCheckpoint(const std::string &path, const std::string &sampler, unsigned int seed) const
+{
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, checkpoint_magic, sizeof(header.magic));
+    header.width = width;
+    header.height = height;
+    header.seed = seed;
+    std::strncpy(header.sampler, sampler.c_str(), sizeof(header.sampler) - 1);
+    header.has_aovs = AOVsEnabled();
+    header.aov_size = sizeof(AOVSample);
+
+    //Written next to the old checkpoint and swapped in at the end, so a crash mid-write leaves the old one intact
+    std::string temp_path = path + ".tmp";
+    {
+        std::ofstream out(temp_path.c_str(), std::ios::binary);
+        if(!out)
+            return false;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        std::vector<float> values(4 * width * height);
+        for(unsigned int i = 0; i < values.size(); i++)
+            values[i] = tile_sums[i].load(std::memory_order_relaxed);
+        out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float));
+        out.write(reinterpret_cast<const char*>(sample_counts.data()), sample_counts.size() * sizeof(unsigned int));
+        values.resize(3 * width * height);
+        for(unsigned int i = 0; i < values.size(); i++)
+            values[i] = splats[i].load(std::memory_order_relaxed);
+        out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float));
+        if(header.has_aovs)
+            out.write(reinterpret_cast<const char*>(aovs.data()), aovs.size() * sizeof(AOVSample));
+        if(!out)
+            return false;
+    }
+    //rename doesn't replace an existing file on every platform
+    if(std::rename(temp_path.c_str(), path.c_str()) != 0)
+    {
+        std::remove(path.c_str());
+        return std::rename(temp_path.c_str(), path.c_str()) == 0;
+    }
+    return true;
+}
+
+bool Film::ReadCheckpoint(const std::string &path, const std::string &sampler, unsigned int seed)
+{
+    std::ifstream in(path.c_str(), std::ios::binary);
+    CheckpointHeader header;
+    if(!in.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+    header.sampler[sizeof(header.sampler) - 1] = 0;
+    if(std::memcmp(header.magic, checkpoint_magic, sizeof(header.magic)) != 0
+            || header.width != width || header.height != height
+            || header.seed != seed || sampler != header.sampler
+            || (header.has_aovs && header.aov_size != sizeof(AOVSample)))
+        return false;
+
+    //Everything is read before the film is touched
+    std::vector<float> sums(4 * width * height), splat_values(3 * width * height);
+    std::vector<unsigned int> counts(width * height);
+    std::vector<AOVSample> saved_aovs(header.has_aovs ? width * height : 0);
+    in.read(reinterpret_cast<char*>(sums.data()), sums.size() * sizeof(float));
+    in.read(reinterpret_cast<char*>(counts.data()), counts.size() * sizeof(unsigned int));
+    in.read(reinterpret_cast<char*>(splat_values.data()), splat_values.size() * sizeof(float));
+    if(header.has_aovs)
+        in.read(reinterpret_cast<char*>(saved_aovs.data()), saved_aovs.size() * sizeof(AOVSample));
+    if(!in)
+        return false;
+
+    for(unsigned int i = 0; i < sums.size(); i++)
+        tile_sums[i].store(sums[i], std::memory_order_relaxed);
+    ClearSplats();
+    for(unsigned int i = 0; i < splat_values.size(); i++)
+    {
+        splats[i].store(splat_values[i], std::memory_order_relaxed);
+        if(splat_values[i] != 0)
+            MarkSplat(i / 3);
+    }
+    sample_counts = counts;
+    //AOVs missing from the checkpoint start over at the next pass
+    if(AOVsEnabled() && header.has_aovs)
+        aovs = saved_aovs;
+    else if(AOVsEnabled())
+        EnableAOVs(true);
+    return true;
+}
+
 void Film::WriteImage(QString path){
-    if(QString::compare(path.right(4), QString(".bmp"), Qt::CaseInsensitive) != 0)
+    QString extension = path.right(4);
+    if(QString::compare(extension, QString(".bmp"), Qt::CaseInsensitive) != 0
+            && QString::compare(extension, QString(".exr"), Qt::CaseInsensitive) != 0
+            && QString::compare(extension, QString(".pfm"), Qt::CaseInsensitive) != 0)
     {
         path.append(QString(".bmp"));
     }
@@ -28,13 +352,67 @@ void Film::WriteImage(QString path){
 }
 
 void Film::WriteImage(const std::string &path){
+    std::string extension = path.size() >= 4 ? path.substr(path.size() - 4) : std::string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if(extension == ".exr")
+    {
+        WriteEXR(path);
+        return;
+    }
+    if(extension == ".pfm")
+        WritePFM(path);
+    else
+        WriteBMP(path);
+    if(AOVsEnabled())
+        WriteEXR(path.substr(0, path.size() - extension.size()) + "_aovs.exr", false);
+}
+
+bool Film::WriteEXR(const std::string &path, bool with_beauty) const
+{
+    EXRWriter writer(width, height);
+    if(with_beauty)
+        writer.AddRGB(std::string(), pixels.data());
+    if(AOVsEnabled())
+    {
+        //Every layer is read in place out of the AOVSample array
+        const AOVSample *a = aovs.data();
+        static_assert(sizeof(AOVSample) % sizeof(float) == 0, "AOV layers are read with a stride in floats");
+        unsigned int stride = sizeof(AOVSample) / sizeof(float);
+        writer.AddChannel("albedo.R", &a->albedo.r, stride);
+        writer.AddChannel("albedo.G", &a->albedo.g, stride);
+        writer.AddChannel("albedo.B", &a->albedo.b, stride);
+        writer.AddChannel("normal.X", &a->normal.x, stride);
+        writer.AddChannel("normal.Y", &a->normal.y, stride);
+        writer.AddChannel("normal.Z", &a->normal.z, stride);
+        writer.AddChannel("direct.R", &a->direct.r, stride);
+        writer.AddChannel("direct.G", &a->direct.g, stride);
+        writer.AddChannel("direct.B", &a->direct.b, stride);
+        writer.AddChannel("indirect.R", &a->indirect.r, stride);
+        writer.AddChannel("indirect.G", &a->indirect.g, stride);
+        writer.AddChannel("indirect.B", &a->indirect.b, stride);
+        //Depth and IDs need more precision than half gives
+        writer.AddChannel("Z", &a->depth, stride, EXRWriter::FLOAT);
+        writer.AddChannel("objectID", &a->object_id, stride, EXRWriter::FLOAT);
+        writer.AddChannel("materialID", &a->material_id, stride, EXRWriter::FLOAT);
+        writer.AddChannel("variance", &a->variance, stride, EXRWriter::FLOAT);
+    }
+    return writer.Write(path);
+}
+
+bool Film::WritePFM(const std::string &path) const
+{
+    return PFMWriter::Write(path, width, height, pixels.data());
+}
+
+void Film::WriteBMP(const std::string &path) const
+{
     BMP output;
     output.SetSize(width, height);
     output.SetBitDepth(24);
 
-    for(unsigned int i = 0; i < width; i++) {
-        for(unsigned int j = 0; j < height; j++) {
-            glm::vec3 color = pixels[i][j];
+    for(unsigned int j = 0; j < height; j++) {
+        for(unsigned int i = 0; i < width; i++) {
+            glm::vec3 color = Pixel(i, j);
             output(i, j)->Red   = glm::clamp(color.r, 0.0f, 1.0f)*255;
             output(i, j)->Green = glm::clamp(color.g, 0.0f, 1.0f)*255;
             output(i, j)->Blue  = glm::clamp(color.b, 0.0f, 1.0f)*255;
@@ -1,15 +1,103 @@
 #pragma once
 #include <la.h>
 #include <vector>
+#include <atomic>
+#include <memory>
+#include <raytracing/aov.h>
+
+class Filter;
+
+//A render thread's private accumulation buffer for one tile, grown by the filter's radius on every side
+//so samples near the tile's edge can splat into the neighboring tiles' pixels without touching shared memory.
+//Each entry holds the filter-weighted color sum and the weight sum.
+class FilmTile
+{
+public:
+    FilmTile();
+    //Covers pixels [x0, x1) x [y0, y1) of the film
+    void Reset(int x0, int y0, int x1, int y1);
+    //Adds a sample at screen position screen to every pixel within the filter's radius
+    void AddSample(const glm::vec2 &screen, const glm::vec3 &color, const Filter &filter);
+    //The (color * weight, weight) sum of pixel (x, y) from the samples added so far
+    const glm::vec4& Sum(int x, int y) const {return sums[(y - y0) * (x1 - x0) + x - x0];}
+    //Adds color with weight 1 to pixel (x, y), for unfiltered rendering
+    void AddPixelSample(int x, int y, const glm::vec3 &color) {sums[(y - y0) * (x1 - x0) + x - x0] += glm::vec4(color, 1);}
+    //The filtered color of pixel (x, y) from the samples added so far
+    glm::vec3 Resolve(int x, int y) const;
+
+    int x0, y0, x1, y1;
+    std::vector<glm::vec4> sums;//(color * weight, weight), row by row
+};
 
 class Film{
 public:
     Film();
     Film(unsigned int width, unsigned int height);
+    //Splats are transient, so copies start with an empty splat buffer
+    Film(const Film &f);
+    Film& operator=(const Film &f);
     unsigned int width, height;
-    std::vector<std::vector<glm::vec3>> pixels;//A 2D array of pixels in which we can store colors
+    std::vector<glm::vec3> pixels;//width * height colors, row by row, so images can be written out without reordering
+    glm::vec3& Pixel(unsigned int x, unsigned int y) {return pixels[y * width + x];}
+    const glm::vec3& Pixel(unsigned int x, unsigned int y) const {return pixels[y * width + x];}
 
     void SetDimensions(unsigned int w, unsigned int h);
+
+    //AOVs are only stored, and only asked of the integrator, once enabled. Each pixel holds the average over its samples.
+    void EnableAOVs(bool enable);
+    bool AOVsEnabled() const {return !aovs.empty();}
+    AOVSample& AOV(unsigned int x, unsigned int y) {return aovs[y * width + x];}
+    std::vector<AOVSample> aovs;//width * height, row by row, empty unless enabled
+
+    //Camera samples traced into each pixel so far. A pass continues every pixel at the sample index after its last one.
+    unsigned int& SampleCount(unsigned int x, unsigned int y) {return sample_counts[y * width + x];}
+    std::vector<unsigned int> sample_counts;//width * height, row by row
+
+    //Light paths connected straight to the camera can land on any pixel, not just the ones a thread owns.
+    //Their contributions go into a separate buffer of atomics so every render thread can splat without locking;
+    //MergeSplats adds them to pixels after each pass. The splats are kept, so later passes add to them.
+    void AddSplat(const glm::vec2 &screen, const glm::vec3 &color);
+    void MergeSplats(float scale);//scale is 1 over the number of light paths traced per pixel
+    //Only resets the pixels splatted since the last clear
+    void ClearSplats();
+    //The pixels that have splats, as indices into pixels, and their unscaled sums. Only the pixels splatted are visited.
+    void GetSplats(std::vector<unsigned int> &indices, std::vector<glm::vec3> &colors) const;
+
+    //Threads add finished tiles, whose borders overlap when filtered, into a shared buffer of atomics,
+    //and ResolveTiles divides the color sums by the weight sums into pixels once all of a pass's tiles are in.
+    //The sums are kept, so each pass refines the one before.
+    void MergeTile(const FilmTile &tile);
+    void ResolveTiles();
+    void ClearTiles();
+    //Clears the sums of pixels [x0, x1) x [y0, y1) only
+    void ClearTiles(int x0, int y0, int x1, int y1);
+    //The (color * weight, weight) sum of pixel (x, y) over the tiles merged so far
+    glm::vec4 Accumulated(unsigned int x, unsigned int y) const;
+
+    //Empties sums, splats, sample counts and AOVs for a new render
+    void ClearAccumulation();
+
+    //Checkpoints hold the sums, sample counts, splats and AOVs, and the sampler type and seed that made them.
+    //Reading one fails and leaves the film alone if the file is unreadable, of another size, or from another sampler.
+    bool WriteCheckpoint(const std::string &path, const std::string &sampler, unsigned int seed) const;
+    bool ReadCheckpoint(const std::string &path, const std::string &sampler, unsigned int seed);
+
+    //The format follows the extension: .exr (half float RGB) and .pfm keep the full range, anything else is a clamped 24-bit BMP.
+    //With AOVs enabled an .exr also holds every AOV layer, and other formats get them in a separate <name>_aovs.exr.
     void WriteImage(const std::string &path);
     void WriteImage(QString path);
+    bool WriteEXR(const std::string &path, bool with_beauty = true) const;
+    bool WritePFM(const std::string &path) const;
+    void WriteBMP(const std::string &path) const;
+
+private:
+    std::unique_ptr<std::atomic<float>[]> splats;//width * height RGB triples, row by row
+    //The pixels splatted since the last clear, so clearing and collecting splats needn't go over the whole film
+    std::unique_ptr<std::atomic<bool>[]> splat_marks;//width * height, set on a pixel's first splat
+    std::unique_ptr<unsigned int[]> splat_pixels;//Indices of the marked pixels; the first splat_pixel_count are valid
+    std::atomic<unsigned int> splat_pixel_count;
+    std::unique_ptr<std::atomic<float>[]> tile_sums;//width * height (RGB * weight, weight) quadruples, row by row
+    //std::atomic<float> has no fetch_add before C++20
+    static void AtomicAdd(std::atomic<float> &a, float v);
+    void MarkSplat(unsigned int index);
 };
@@ -0,0 +1,59 @@
+#include <raytracing/filters/filter.h>
+
+Filter::Filter(float r) : radius(glm::clamp(r, 0.5f, float(max_radius)))
+{
+    for(int i = 0; i < table_size; i++)
+        table[i] = 0;
+}
+
+void Filter::BuildTable()
+{
+    for(int i = 0; i < table_size; i++)
+        table[i] = Evaluate1D((i + 0.5f) / table_size * radius);
+}
+
+float Filter::Lookup(float x) const
+{
+    x = glm::abs(x);
+    if(x >= radius)
+        return 0;
+    return table[glm::min(int(x / radius * table_size), table_size - 1)];
+}
+
+GaussianFilter::GaussianFilter(float radius, float alpha) : Filter(radius), alpha(alpha)
+{
+    edge = glm::exp(-alpha * this->radius * this->radius);
+    BuildTable();
+}
+
+float GaussianFilter::Evaluate1D(float x) const
+{
+    return glm::max(0.0f, glm::exp(-alpha * x * x) - edge);
+}
+
+MitchellFilter::MitchellFilter(float radius, float B, float C) : Filter(radius), B(B), C(C)
+{
+    BuildTable();
+}
+
+float MitchellFilter::Evaluate1D(float x) const
+{
+    //The cubic is defined over [-2, 2]
+    x = glm::abs(2.0f * x / radius);
+    if(x > 1)
+        return ((-B - 6*C) * x*x*x + (6*B + 30*C) * x*x + (-12*B - 48*C) * x + (8*B + 24*C)) / 6.0f;
+    return ((12 - 9*B - 6*C) * x*x*x + (-18 + 12*B + 6*C) * x*x + (6 - 2*B)) / 6.0f;
+}
+
+BlackmanHarrisFilter::BlackmanHarrisFilter(float radius) : Filter(radius)
+{
+    BuildTable();
+}
+
+float BlackmanHarrisFilter::Evaluate1D(float x) const
+{
+    //Window position in [0, 1], peaking at x = 0
+    float t = 0.5f + 0.5f * x / radius;
+    float w = 2.0f * PI * t;
+    return 0.35875f - 0.48829f * glm::cos(w) + 0.14128f * glm::cos(2 * w) - 0.01168f * glm::cos(3 * w);
+}
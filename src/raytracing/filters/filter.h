@@ -0,0 +1,62 @@
+#pragma once
+#include <la.h>
+
+//A pixel reconstruction filter. Each camera sample adds color * weight and weight to every pixel center
+//within radius of it, and a pixel's color is the ratio of the two sums.
+//Every filter here is separable, so the weight of an offset (x, y) is Evaluate1D(x) * Evaluate1D(y),
+//and Evaluate1D is tabulated once on construction so splatting never calls exp or cos.
+class Filter
+{
+public:
+    //radius is in pixels and is clamped to [0.5, max_radius]
+    Filter(float radius);
+    virtual ~Filter(){}
+
+    float Radius() const {return radius;}
+    //Tabulated 1D weight for an offset of x pixels from a pixel center
+    float Lookup(float x) const;
+    float Evaluate(const glm::vec2 &offset) const {return Lookup(offset.x) * Lookup(offset.y);}
+
+    //The exact 1D profile, for |x| < radius
+    virtual float Evaluate1D(float x) const = 0;
+
+    static const int max_radius = 4;
+    static const int table_size = 64;
+
+protected:
+    //Subclasses call this from their constructors, once Evaluate1D can be dispatched to them
+    void BuildTable();
+
+    float radius;
+    float table[table_size];//Evaluate1D at the middle of each of table_size steps over [0, radius)
+};
+
+//exp(-alpha x^2), shifted down so it reaches 0 at the radius
+class GaussianFilter : public Filter
+{
+public:
+    GaussianFilter(float radius, float alpha);
+    virtual float Evaluate1D(float x) const;
+protected:
+    float alpha;
+    float edge;
+};
+
+//Mitchell-Netravali cubic. B = C = 1/3 is the usual compromise between blurring and ringing.
+//The negative lobes sharpen edges, so a pixel's summed weight can come out below the sum of its samples'.
+class MitchellFilter : public Filter
+{
+public:
+    MitchellFilter(float radius, float B, float C);
+    virtual float Evaluate1D(float x) const;
+protected:
+    float B, C;
+};
+
+//Four-term Blackman-Harris window over [-radius, radius]. Nearly as sharp as Mitchell with no negative lobes.
+class BlackmanHarrisFilter : public Filter
+{
+public:
+    BlackmanHarrisFilter(float radius);
+    virtual float Evaluate1D(float x) const;
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include <la.h>
+#include <cmath>
+
+//An orthonormal shading basis around a surface normal.
+//tangent, bitangent and normal map to the local X, Y and Z axes that every BxDF assumes,
+//so converting a direction between world space and BxDF space is a plain 3x3 rotation.
+class Frame
+{
+public:
+    Frame():
+        tangent(1,0,0),
+        bitangent(0,1,0),
+        normal(0,0,1)
+    {}
+
+    //Builds the tangent and bitangent from a unit normal without branching on its orientation
+    //(Duff et al. 2017, "Building an Orthonormal Basis, Revisited").
+    explicit Frame(const glm::vec3 &n):
+        normal(n)
+    {
+        float sign = std::copysign(1.0f, n.z);
+        float a = -1.0f / (sign + n.z);
+        float b = n.x * n.y * a;
+        tangent = glm::vec3(1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+        bitangent = glm::vec3(b, sign + n.y * n.y * a, -n.y);
+    }
+
+    //The basis is orthonormal, so world-to-local is the transpose of local-to-world.
+    inline glm::vec3 ToLocal(const glm::vec3 &w_world) const
+    {
+        return glm::vec3(glm::dot(w_world, tangent), glm::dot(w_world, bitangent), glm::dot(w_world, normal));
+    }
+
+    inline glm::vec3 ToWorld(const glm::vec3 &w_local) const
+    {
+        return tangent * w_local.x + bitangent * w_local.y + normal * w_local.z;
+    }
+
+    glm::vec3 tangent;
+    glm::vec3 bitangent;
+    glm::vec3 normal;
+};
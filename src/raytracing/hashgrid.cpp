@@ -0,0 +1,95 @@
+#include <raytracing/hashgrid.h>
+
+HashGrid::HashGrid():
+    radius2(0), inv_cell_size(0)
+{}
+
+void HashGrid::Clear()
+{
+    positions.clear();
+    order.clear();
+    bucket_ends.clear();
+}
+
+unsigned int HashGrid::CellIndex(int x, int y, int z) const
+{
+    //Teschner et al. 2003, "Optimized Spatial Hashing for Collision Detection of Deformable Objects"
+    unsigned int h = ((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u) ^ ((unsigned int)z * 83492791u);
+    return h % bucket_ends.size();
+}
+
+void HashGrid::Build(const std::vector<glm::vec3> &points, float r)
+{
+    Clear();
+    if(points.empty() || r <= 0)
+        return;
+
+    radius2 = r * r;
+    inv_cell_size = 1.0f / (2.0f * r);
+    minBounding = glm::vec3(INFINITY);
+    for(const glm::vec3 &p : points)
+        minBounding = glm::min(minBounding, p);
+
+    //Count the points in each bucket, turn the counts into ends, then fill the buckets back to front
+    bucket_ends.assign(points.size(), 0);
+    std::vector<unsigned int> bucket_of(points.size());
+    for(unsigned int i = 0; i < points.size(); i++)
+    {
+        glm::ivec3 cell(glm::floor((points[i] - minBounding) * inv_cell_size));
+        bucket_of[i] = CellIndex(cell.x, cell.y, cell.z);
+        bucket_ends[bucket_of[i]]++;
+    }
+    for(unsigned int b = 1; b < bucket_ends.size(); b++)
+        bucket_ends[b] += bucket_ends[b-1];
+
+    order.resize(points.size());
+    positions.resize(points.size());
+    std::vector<int> fill(bucket_ends);
+    for(int i = int(points.size()) - 1; i >= 0; i--)
+    {
+        int slot = --fill[bucket_of[i]];
+        order[slot] = i;
+        positions[slot] = points[i];
+    }
+}
+
+const std::vector<int>& HashGrid::Order() const
+{
+    return order;
+}
+
+void HashGrid::QueryWithin(const glm::vec3 &p, float r2, std::vector<int> &result) const
+{
+    result.clear();
+    if(positions.empty())
+        return;
+
+    //Cells are 2r wide, so the sphere overlaps at most the two nearest cells along each axis
+    glm::vec3 c = (p - minBounding) * inv_cell_size;
+    glm::vec3 f = glm::floor(c);
+    glm::ivec3 lo(f);
+    glm::ivec3 step(c.x - f.x < 0.5f ? -1 : 1, c.y - f.y < 0.5f ? -1 : 1, c.z - f.z < 0.5f ? -1 : 1);
+
+    unsigned int visited[8];
+    int visited_count = 0;
+    for(int k = 0; k < 8; k++)
+    {
+        unsigned int b = CellIndex(lo.x + ((k & 1) ? step.x : 0),
+                                   lo.y + ((k & 2) ? step.y : 0),
+                                   lo.z + ((k & 4) ? step.z : 0));
+        //Different cells can hash to the same bucket; it only needs scanning once
+        bool seen = false;
+        for(int v = 0; v < visited_count; v++)
+            seen = seen || visited[v] == b;
+        if(seen)
+            continue;
+        visited[visited_count++] = b;
+
+        int begin = b == 0 ? 0 : bucket_ends[b-1];
+        for(int i = begin; i < bucket_ends[b]; i++)
+        {
+            if(glm::distance2(positions[i], p) <= r2)
+                result.push_back(i);
+        }
+    }
+}
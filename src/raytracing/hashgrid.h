@@ -0,0 +1,36 @@
+#pragma once
+#include <la.h>
+#include <vector>
+
+//A uniform grid over a point set with cells as wide as the search diameter, hashed into as many buckets as there are points.
+//Built in O(n) with a counting sort, so it is cheap to rebuild every iteration; a radius query looks at the 2x2x2 cells
+//that can overlap the search sphere.
+//The points are kept sorted by bucket so a query reads contiguous memory. Queries return slots in that order;
+//callers keep their per-point data in the same order by permuting it with Order() after each build.
+class HashGrid
+{
+public:
+    HashGrid();
+
+    void Build(const std::vector<glm::vec3> &points, float radius);
+    void Clear();
+
+    //Fills result with the slots of every point within the build radius of p. result is cleared first.
+    void Query(const glm::vec3 &p, std::vector<int> &result) const {QueryWithin(p, radius2, result);}
+    //Same within radius of p, which is clamped to the build radius since that sets how wide the cells are
+    void Query(const glm::vec3 &p, float radius, std::vector<int> &result) const {QueryWithin(p, glm::min(radius * radius, radius2), result);}
+    //The index in the built point list of the point in each slot
+    const std::vector<int>& Order() const;
+
+private:
+    unsigned int CellIndex(int x, int y, int z) const;
+    void QueryWithin(const glm::vec3 &p, float r2, std::vector<int> &result) const;
+
+    std::vector<glm::vec3> positions;//Sorted by bucket
+    std::vector<int> order;
+    std::vector<int> bucket_ends;//Slots [bucket_ends[b-1], bucket_ends[b]) hold bucket b
+
+    glm::vec3 minBounding;
+    float radius2;
+    float inv_cell_size;
+};
@@ -0,0 +1,172 @@
+#include <raytracing/hdrwriter.h>
+#include <algorithm>
+#include <cstring>
+
+bool PFMWriter::Write(const std::string &path, unsigned int width, unsigned int height, const glm::vec3 *rgb)
+{
+    std::ofstream out(path.c_str(), std::ios::binary);
+    if(!out)
+        return false;
+    //A negative scale marks the data as little-endian
+    out << "PF\n" << width << " " << height << "\n-1.0\n";
+    //glm::vec3 is three packed floats, so every row goes out as it is stored
+    for(unsigned int y = height; y-- > 0;)
+        out.write(reinterpret_cast<const char*>(rgb + y * width), 3 * sizeof(float) * width);
+    return bool(out);
+}
+
+EXRWriter::EXRWriter(unsigned int width, unsigned int height) : width(width), height(height)
+{}
+
+void EXRWriter::AddChannel(const std::string &name, const float *data, unsigned int stride, PixelType type)
+{
+    Channel c = {name, data, stride, type};
+    channels.push_back(c);
+}
+
+void EXRWriter::AddRGB(const std::string &layer, const glm::vec3 *rgb, PixelType type)
+{
+    std::string prefix = layer.empty() ? std::string() : layer + ".";
+    const float *data = reinterpret_cast<const float*>(rgb);
+    AddChannel(prefix + "R", data, 3, type);
+    AddChannel(prefix + "G", data + 1, 3, type);
+    AddChannel(prefix + "B", data + 2, 3, type);
+}
+
+unsigned short EXRWriter::FloatToHalf(float f)
+{
+    unsigned int bits;
+    std::memcpy(&bits, &f, 4);
+    unsigned short sign = (bits >> 16) & 0x8000;
+    int exponent = int((bits >> 23) & 0xff) - 127 + 15;
+    unsigned int mantissa = bits & 0x7fffff;
+
+    if(((bits >> 23) & 0xff) == 0xff)
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);//Inf or NaN
+    if(exponent >= 31)
+        return sign | 0x7c00;//Too large, becomes Inf
+    if(exponent <= 0)
+    {
+        //Denormal half, or zero once the value is below half's smallest denormal
+        if(exponent < -10)
+            return sign;
+        mantissa |= 0x800000;
+        unsigned int shift = 14 - exponent;
+        unsigned int half_mantissa = mantissa >> shift;
+        //Round to nearest even
+        unsigned int rest = mantissa & ((1u << shift) - 1);
+        unsigned int halfway = 1u << (shift - 1);
+        if(rest > halfway || (rest == halfway && (half_mantissa & 1)))
+            half_mantissa++;
+        return sign | half_mantissa;
+    }
+    unsigned int result = (exponent << 10) | (mantissa >> 13);
+    unsigned int rest = mantissa & 0x1fff;
+    //Round to nearest even. A carry out of the mantissa correctly bumps the exponent, up to Inf.
+    if(rest > 0x1000 || (rest == 0x1000 && (result & 1)))
+        result++;
+    return sign | result;
+}
+
+template<typename T> void EXRWriter::Append(std::vector<char> &bytes, T value)
+{
+    //EXR is little-endian, as is every platform this builds on
+    const char *p = reinterpret_cast<const char*>(&value);
+    bytes.insert(bytes.end(), p, p + sizeof(T));
+}
+
+void EXRWriter::WriteAttribute(std::ofstream &out, const char *name, const char *type, const std::vector<char> &value)
+{
+    out.write(name, std::strlen(name) + 1);
+    out.write(type, std::strlen(type) + 1);
+    int size = value.size();
+    out.write(reinterpret_cast<const char*>(&size), 4);
+    out.write(value.data(), size);
+}
+
+bool EXRWriter::Write(const std::string &path)
+{
+    std::ofstream out(path.c_str(), std::ios::binary);
+    if(!out || channels.empty())
+        return false;
+
+    //Readers expect the channel list, and the channels within each scanline, in name order
+    std::vector<Channel> sorted = channels;
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Channel &a, const Channel &b){return a.name < b.name;});
+
+    int magic = 20000630;
+    int version = 2;//Single-part scanline file
+    out.write(reinterpret_cast<const char*>(&magic), 4);
+    out.write(reinterpret_cast<const char*>(&version), 4);
+
+    std::vector<char> value;
+    for(const Channel &c : sorted)
+    {
+        value.insert(value.end(), c.name.begin(), c.name.end());
+        value.push_back(0);
+        Append<int>(value, c.type);
+        Append<int>(value, 0);//pLinear and three reserved bytes
+        Append<int>(value, 1);//x and y sampling
+        Append<int>(value, 1);
+    }
+    value.push_back(0);
+    WriteAttribute(out, "channels", "chlist", value);
+
+    value.assign(1, 0);//NO_COMPRESSION
+    WriteAttribute(out, "compression", "compression", value);
+
+    value.clear();
+    Append<int>(value, 0);
+    Append<int>(value, 0);
+    Append<int>(value, int(width) - 1);
+    Append<int>(value, int(height) - 1);
+    WriteAttribute(out, "dataWindow", "box2i", value);
+    WriteAttribute(out, "displayWindow", "box2i", value);
+
+    value.assign(1, 0);//INCREASING_Y
+    WriteAttribute(out, "lineOrder", "lineOrder", value);
+
+    value.clear();
+    Append<float>(value, 1.0f);
+    WriteAttribute(out, "pixelAspectRatio", "float", value);
+    WriteAttribute(out, "screenWindowWidth", "float", value);
+
+    value.clear();
+    Append<float>(value, 0.0f);
+    Append<float>(value, 0.0f);
+    WriteAttribute(out, "screenWindowCenter", "v2f", value);
+    out.put(0);//End of header
+
+    //Uncompressed chunks all have the same size, so the offset table is known before any pixels are written
+    unsigned int line_bytes = 0;
+    for(const Channel &c : sorted)
+        line_bytes += width * (c.type == HALF ? 2 : 4);
+    unsigned long long offset = (unsigned long long)out.tellp() + 8ull * height;
+    for(unsigned int y = 0; y < height; y++)
+    {
+        out.write(reinterpret_cast<const char*>(&offset), 8);
+        offset += 8 + line_bytes;
+    }
+
+    //Each chunk is the line's y, its size, then the whole line of each channel in turn
+    std::vector<char> line;
+    line.reserve(line_bytes + 8);
+    for(unsigned int y = 0; y < height; y++)
+    {
+        line.clear();
+        Append<int>(line, y);
+        Append<int>(line, line_bytes);
+        for(const Channel &c : sorted)
+        {
+            const float *p = c.data + (size_t)y * width * c.stride;
+            if(c.type == HALF)
+                for(unsigned int x = 0; x < width; x++)
+                    Append<unsigned short>(line, FloatToHalf(p[x * c.stride]));
+            else
+                for(unsigned int x = 0; x < width; x++)
+                    Append<float>(line, p[x * c.stride]);
+        }
+        out.write(line.data(), line.size());
+    }
+    return bool(out);
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <la.h>
+#include <string>
+#include <vector>
+#include <fstream>
+
+//Float image output for compositing and denoising, where BMP's clamped 8 bits would lose the dynamic range.
+//Both writers stream one scanline at a time straight out of row-major float buffers,
+//so the only memory they use besides the image is a single line.
+
+//Portable float map: three little-endian floats per pixel, written bottom row first.
+class PFMWriter
+{
+public:
+    //rgb holds width * height colors, row by row from the top
+    static bool Write(const std::string &path, unsigned int width, unsigned int height, const glm::vec3 *rgb);
+};
+
+//Uncompressed scanline OpenEXR with any number of named channels, stored as half or float.
+//Layers are written as channels named "layer.R", "layer.G", ...
+class EXRWriter
+{
+public:
+    enum PixelType {HALF = 1, FLOAT = 2};
+
+    EXRWriter(unsigned int width, unsigned int height);
+    //data points at channel's value for pixel (0, 0); pixel (x, y) is at data[(y * width + x) * stride]
+    void AddChannel(const std::string &name, const float *data, unsigned int stride, PixelType type = HALF);
+    //The three channels of an RGB buffer. An empty layer name gives the plain R, G, B channels.
+    void AddRGB(const std::string &layer, const glm::vec3 *rgb, PixelType type = HALF);
+    bool Write(const std::string &path);
+
+    static unsigned short FloatToHalf(float f);
+
+private:
+    struct Channel
+    {
+        std::string name;
+        const float *data;
+        unsigned int stride;
+        PixelType type;
+    };
+
+    void WriteAttribute(std::ofstream &out, const char *name, const char *type, const std::vector<char> &value);
+    template<typename T> static void Append(std::vector<char> &bytes, T value);
+
+    unsigned int width, height;
+    std::vector<Channel> channels;
+};
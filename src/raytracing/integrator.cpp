@@ -1,21 +1,78 @@
 #include <raytracing/integrator.h>
-#include <QStack>
+#include <raytracing/samplers/sobolsampler.h>
 
 Integrator::Integrator():
-    max_depth(5),
     Number_Light(10),
-    Number_BRDF(10)
+    Number_BRDF(10),
+    rr_depth(3),
+    rr_min_survival(0.05f),
+    rr_max_survival(1.0f),
+    max_depth(5),
+    sampler_generation(0)
 {
-    //random number generator and uniform distribution
-    generator = std::mt19937(std::chrono::system_clock::now().time_since_epoch().count());
-    uniform_distribution = std::uniform_real_distribution<float>(0.0f,1.0f);
-
     scene = NULL;
     intersection_engine = NULL;
+    sampler = new SobolSampler();
 
     //std::cout<<"Integrator constructor here!\n";
 }
 
+Integrator::~Integrator()
+{
+    delete sampler;
+}
+
+void Integrator::SetSampler(Sampler *s)
+{
+    delete sampler;
+    sampler = s;
+    //Threads that already cloned the old prototype see the new generation and clone again
+    sampler_generation++;
+}
+
+Sampler* Integrator::ThreadSampler()
+{
+    unsigned int generation = sampler_generation;
+    if(!thread_samplers.hasLocalData() || thread_samplers.localData()->generation != generation)
+        thread_samplers.setLocalData(new ThreadSamplerSlot(sampler->Clone(), generation));
+    return thread_samplers.localData()->sampler;
+}
+
+AOVSample* Integrator::ThreadAOV()
+{
+    return thread_aovs.hasLocalData() ? *thread_aovs.localData() : NULL;
+}
+
+void Integrator::SetThreadAOV(AOVSample *aov)
+{
+    if(!thread_aovs.hasLocalData())
+        thread_aovs.setLocalData(new AOVSample*(NULL));
+    *thread_aovs.localData() = aov;
+}
+
+void Integrator::SeedThreadGenerator(unsigned int seed)
+{
+    if(!thread_generators.hasLocalData())
+        thread_generators.setLocalData(new std::mt19937(seed));
+    else
+        thread_generators.localData()->seed(seed);
+}
+
+float Integrator::GetUniform()
+{
+    if(!thread_generators.hasLocalData())
+        thread_generators.setLocalData(new std::mt19937(std::chrono::system_clock::now().time_since_epoch().count()));
+    std::uniform_real_distribution<float> uniform_distribution(0.0f,1.0f);
+    return uniform_distribution(*thread_generators.localData());
+}
+
+glm::vec3 Integrator::SampleBSDF(const Intersection &isx, const glm::vec3 &wo_local, glm::vec3 &wi_local, float &pdf)
+{
+    float u0 = Get1D();
+    glm::vec2 u = Get2D();
+    return isx.object_hit->material->SampleAndEvaluateScatteredEnergy(isx, wo_local, wi_local, u0, u.x, u.y, pdf);
+}
+
 glm::vec3 ComponentMult(const glm::vec3 &a, const glm::vec3 &b)
 {
     return glm::vec3(a.x * b.x, a.y * b.y, a.z * b.z);
@@ -38,111 +95,130 @@ float Integrator::PowerHeuristic(const float &pdf_s, const float &n_s, const flo
         return glm::pow(pdf_s * n_s,2.0f) / (glm::pow(pdf_s * n_s,2.0f) + glm::pow(pdf_f * n_f,2.0f));
 }
 
+void Integrator::SetRussianRoulette(unsigned int depth, float min_survival, float max_survival)
+{
+    rr_depth = depth;
+    rr_min_survival = glm::clamp(min_survival, 1e-3f, 1.0f);
+    rr_max_survival = glm::clamp(max_survival, rr_min_survival, 1.0f);
+}
+
 //Russian roulette
-bool Integrator::RussianRoulette(const glm::vec3 &color,const int& depth)
+bool Integrator::RussianRoulette(glm::vec3 &beta, unsigned int depth)
 {
-    if(depth <= 2)
+    if(depth < rr_depth)
         return false;
 
-    float maxElemet = glm::max(glm::max(color.x,color.y),color.z);
-
-    throughput *= maxElemet;
-
-    if(uniform_distribution(generator) > throughput)
+    //Paths carrying little energy are likely to stop; the floor keeps dim paths from being killed outright
+    float q = glm::clamp(glm::max(glm::max(beta.x, beta.y), beta.z), rr_min_survival, rr_max_survival);
+    if(Get1D() >= q)
         return true;
 
+    //Survivors stand in for the paths that were terminated
+    beta /= q;
     return false;
-
 }
 
-glm::vec3 Integrator::EstimateLight(Geometry *& light, Ray r,unsigned int depth)
+glm::vec3 Integrator::EstimateLight(Intersection intersection, Ray r, unsigned int depth, AOVSample *aov)
 {
-    QStack<glm::vec3> FS;
-    QStack<glm::vec3> directLight;
-    FS.clear();directLight.clear();
-
+    unsigned int first_depth = depth;
+    glm::vec3 color(0);
+    glm::vec3 pathThroughput(1.0f);//Product of F * |cos| / pdf over the bounces so far, over the roulette survival probabilities
 
-    throughput = 1.0f;
     while(depth < max_depth)
     {
-
-        Intersection intersection = intersection_engine->GetIntersection(r);
-        if(intersection.t > 0 && intersection.object_hit->material->is_light_source)
-        {   
-            //F_absdot.push(glm::vec3(1));
-            //directLight.push(intersection.object_hit->material->base_color * intersection.texture_color);
+        //Emission found by a bounce is already counted by the previous vertex's direct light estimate
+        if(intersection.t <= 0 || intersection.object_hit->material->is_light_source)
             break;
-        }
-
-        if(intersection.t > 0)
-        {
-            glm::vec3 wo_world = -r.direction;
-            glm::vec3 wo_local = intersection.ToLocalNormalCoordinate(wo_world);
-            glm::vec3 wj_world;
-            glm::vec3 wj_local;
-
-            glm::vec3 F;
-            float absDot;
-            float pdf;
 
-            glm::vec3 Ld = EstimateDirectLight(intersection,r,light,wj_world);
-
-            //wj_local = intersection.ToLocalNormalCoordinate(wj_world);
-
-            F = intersection.object_hit->material->SampleAndEvaluateScatteredEnergy(intersection,
-                                                                           wo_local,
-                                                                           wj_local,pdf);
-            wj_world = intersection.ToWorldNormalCoordinate(wj_local);
+        glm::vec3 wo_local = intersection.ToLocalNormalCoordinate(-r.direction);
+        glm::vec3 wj_world;
+        glm::vec3 wj_local;
+        float pdf;
 
-            absDot  = glm::abs(glm::dot(intersection.normal,wj_world));
+        //One light per vertex, picked by the light tree; dividing by its pdf estimates the sum over all lights
+        float lightPdf;
+        Geometry* light = scene->light_sampler.Sample(intersection.point, Get1D(), lightPdf);
+        if(light != NULL && lightPdf > 0)
+        {
+            glm::vec3 Ld = pathThroughput * EstimateDirectLight(intersection,r,light,wj_world) / lightPdf;
+            color += Ld;
+            if(aov != NULL)
+                aov->AddRadiance(Ld, depth - first_depth);
+        }
 
-            directLight.push(Ld);
-            if(isinf(pdf))
-                FS.push(F);
-            else
-                FS.push(F*absDot);
+        glm::vec3 F = SampleBSDF(intersection,
+                                 wo_local,
+                                 wj_local,pdf);
+        if(pdf <= 0)
+            break;
+        wj_world = intersection.ToWorldNormalCoordinate(wj_local);
+        float absDot = glm::abs(glm::dot(intersection.normal,wj_world));
 
-            r = Ray(intersection.point + glm::sign(glm::dot(wj_world,intersection.normal)) * 1e-3f*intersection.normal,wj_world);
+        //Delta lobes return F already divided by their pdf
+        glm::vec3 bounce = isinf(pdf) ? F : F * absDot / pdf;
+        pathThroughput *= bounce;
 
-            //Russian Roulette
-            if(RussianRoulette(F*absDot, depth))
-                break;
-        }
-        else
-        {
+        if(RussianRoulette(pathThroughput, depth))
             break;
-        }
 
+        r = Ray(intersection.point + glm::sign(glm::dot(wj_world,intersection.normal)) * 1e-3f*intersection.normal,wj_world);
+        intersection = intersection_engine->GetIntersection(r);
         depth++;
     }
 
-    glm::vec3 indirectLight(0);
-    while(!directLight.empty() && !FS.empty())
-    {
-        glm::vec3 F = FS.pop();
-        glm::vec3 direct = directLight.pop();
-
-        indirectLight = F * (indirectLight) + direct;
-    }
-
-    return indirectLight;
+    return color;
 }
 //Basic ray trace
 glm::vec3 Integrator::TraceRay(Ray r, unsigned int depth)
 {
 
     Intersection intersection = intersection_engine->GetIntersection(r);
+    AOVSample* aov = ThreadAOV();
+    if(aov != NULL)
+    {
+        aov->SetFirstHit(intersection);
+        aov->has_split = true;
+    }
     if(intersection.t > 0 && intersection.object_hit->material->is_light_source)
     {
-        return intersection.texture_color * intersection.object_hit->material->base_color;
+        glm::vec3 Le = intersection.texture_color * intersection.object_hit->material->base_color;
+        if(aov != NULL)
+            aov->direct += Le;
+        return Le;
     }
 
-    glm::vec3 color(0);
-    for(Geometry* light : scene->lights)
-       color = color + EstimateLight(light,r,depth);
+    return EstimateLight(intersection,r,depth,aov);
 
-    return color;
+}
 
+void Integrator::TraceRays(const std::vector<Ray> &rays, const std::vector<SamplerState> &states, std::vector<glm::vec3> &colors,
+                           std::vector<AOVSample> *aovs)
+{
+    colors.resize(rays.size());
+    if(aovs != NULL)
+        aovs->assign(rays.size(), AOVSample());
+    for(unsigned int i = 0; i < rays.size(); i++)
+    {
+        if(!states.empty())
+            ThreadSampler()->SetState(states[i]);
+        if(aovs == NULL)
+        {
+            colors[i] = TraceRay(rays[i], 0);
+            continue;
+        }
+
+        AOVSample &aov = (*aovs)[i];
+        SetThreadAOV(&aov);
+        colors[i] = TraceRay(rays[i], 0);
+        SetThreadAOV(NULL);
+        if(!aov.has_first_hit)
+            aov.SetFirstHit(intersection_engine->GetIntersection(rays[i]));
+        if(!aov.has_split)
+        {
+            aov.direct = colors[i];
+            aov.has_split = true;
+        }
+    }
 }
 
 DirectLightingIntegrator::DirectLightingIntegrator()
@@ -159,8 +235,9 @@ glm::vec3 Integrator::MIS_SampleLight(Intersection &intersection, Ray &r, Geomet
     glm::vec3 sum_light_sample(0);
     for(int i = 0; i < Number_Light; i++)
     {
-        float u = uniform_distribution(generator);
-        float v = uniform_distribution(generator);
+        glm::vec2 uv = Get2D();
+        float u = uv.x;
+        float v = uv.y;
 
         Intersection lightSample = light->SampleOnGeometrySurface(u, v, intersection.point + 1e-3f * intersection.normal);
         //Intersection lightSample = light->RandomSampleOnSurface(u,v);
@@ -206,7 +283,7 @@ glm::vec3 Integrator::MIS_SampleBRDF(Intersection &intersection, Ray &r, Geometr
         glm::vec3 wo_local = intersection.ToLocalNormalCoordinate(-r.direction);
         glm::vec3 wj_local;
         float pdf_brdf;
-        glm::vec3 F = intersection.object_hit->material->SampleAndEvaluateScatteredEnergy(intersection,wo_local,wj_local,pdf_brdf);
+        glm::vec3 F = SampleBSDF(intersection,wo_local,wj_local,pdf_brdf);
 
         glm::vec3 wj_world = intersection.ToWorldNormalCoordinate(wj_local);
         glm::vec3 wo_world = - r.direction;
@@ -247,8 +324,9 @@ glm::vec3 Integrator::MIS_SampleLight_Ld(Intersection &intersection, Ray &r, Geo
     glm::vec3 sum_light_sample(0);
     for(int i = 0; i < Number_Light; i++)
     {
-        float u = uniform_distribution(generator);
-        float v = uniform_distribution(generator);
+        glm::vec2 uv = Get2D();
+        float u = uv.x;
+        float v = uv.y;
 
         Intersection lightSample = light->SampleOnGeometrySurface(u, v, intersection.point + 1e-3f * intersection.normal);
         glm::vec3 wj = glm::normalize(lightSample.point - intersection.point);
@@ -291,7 +369,7 @@ glm::vec3 Integrator::MIS_SampleBRDF_Ld(Intersection &intersection, Ray &r, Geom
     glm::vec3 wo_local = intersection.ToLocalNormalCoordinate(-r.direction);
     glm::vec3 wj_local;
     float pdf_brdf;
-    glm::vec3 F = intersection.object_hit->material->SampleAndEvaluateScatteredEnergy(intersection,wo_local,wj_local,pdf_brdf);
+    glm::vec3 F = SampleBSDF(intersection,wo_local,wj_local,pdf_brdf);
 
     glm::vec3 wj_world = intersection.ToWorldNormalCoordinate(wj_local);
     glm::vec3 wo_world = - r.direction;
@@ -360,13 +438,12 @@ glm::vec3 DirectLightingIntegrator::TraceRay(Ray r, unsigned int depth)
         glm::vec3 sample_light(0);
         glm::vec3 sample_brdf(0);
 
-        for(Geometry* light : scene->lights)
+        float lightPdf;
+        Geometry* light = scene->light_sampler.Sample(intersection.point, Get1D(), lightPdf);
+        if(light != NULL && lightPdf > 0)
         {
-            glm::vec3 sample_light_i = MIS_SampleLight(intersection, r, light);
-            sample_light = sample_light + sample_light_i;
-
-            glm::vec3 sample_brdf_i = MIS_SampleBRDF(intersection, r, light);
-            sample_brdf = sample_brdf + sample_brdf_i;
+            sample_light = MIS_SampleLight(intersection, r, light) / lightPdf;
+            sample_brdf = MIS_SampleBRDF(intersection, r, light) / lightPdf;
         }
 
         // combined result
@@ -4,6 +4,10 @@
 #include <raytracing/intersection.h>
 #include <raytracing/intersectionengine.h>
 #include <scene/scene.h>
+#include <raytracing/samplers/sampler.h>
+#include <raytracing/aov.h>
+#include <QThreadStorage>
+#include <atomic>
 
 class Scene;
 
@@ -21,17 +25,40 @@ public:
 
     Integrator();
     Integrator(Scene *s);
+    virtual ~Integrator();
     virtual glm::vec3 TraceRay(Ray r, unsigned int depth);
+    //Traces a batch of camera rays, colors[i] receiving the color of rays[i]. Depth-first integrators just call TraceRay on each.
+    //When states is not empty, ray i continues the sample that states[i] describes, as left after the camera drew from it.
+    //When aovs is not NULL, (*aovs)[i] receives ray i's AOVs. Whatever the integrator doesn't record itself is filled in
+    //afterwards: the first hit by one more intersection, and the whole color as direct light.
+    virtual void TraceRays(const std::vector<Ray> &rays, const std::vector<SamplerState> &states, std::vector<glm::vec3> &colors,
+                           std::vector<AOVSample> *aovs = NULL);
     void SetDepth(unsigned int depth);
 
     Scene* scene;
     IntersectionEngine* intersection_engine;
     unsigned int getMaxDepth(){return max_depth;}
 
-    //random number generator and uniform distribution
+    //Takes ownership of s, the prototype every thread's sampler is cloned from. The default is a SobolSampler.
+    //Every thread clones the new prototype on its next use. The old one is deleted, so no thread may be rendering.
+    void SetSampler(Sampler* s);
+    const Sampler& GetSampler() const {return *sampler;}
+    //This thread's sampler, cloned from the prototype on first use. Paths draw every random number from it.
+    Sampler* ThreadSampler();
+    float Get1D() {return ThreadSampler()->Get1D();}
+    glm::vec2 Get2D() {return ThreadSampler()->Get2D();}
+    //Material::SampleAndEvaluateScatteredEnergy with the lobe choice and direction drawn from the thread's sampler
+    glm::vec3 SampleBSDF(const Intersection &isx, const glm::vec3 &wo_local, glm::vec3 &wi_local, float &pdf);
+
+    //The AOV record of the camera sample this thread is tracing, or NULL when AOVs are off. TraceRay writes into it.
+    AOVSample* ThreadAOV();
+    void SetThreadAOV(AOVSample* aov);
+
+    //This thread's random number generator, for work that belongs to no camera sample (photon and light path passes).
+    //Render threads seed their own; a thread that never does starts from the clock.
+    void SeedThreadGenerator(unsigned int seed);
+    float GetUniform();//In [0,1), from the thread's generator
     int seed;
-    std::mt19937 generator;//(std::chrono::system_clock::now().time_since_epoch().count());
-    std::uniform_real_distribution<float> uniform_distribution;//(0.0f,1.0f);
 
     float PowerHeuristic(const float &pdf_s, const float &n_s, const float &pdf_f, const float &n_f);
 
@@ -46,14 +73,38 @@ public:
 
     //glm::vec3 EstimateIndirectLight(Intersection &, Ray &, glm::vec3 &,float &pdf);
 
-    glm::vec3 EstimateLight(Geometry* &light, Ray r, unsigned int depth);
+    //Follows the path that r starts (isx is r's first hit) for up to max_depth bounces in a single forward pass.
+    //Each vertex adds its one-light direct estimate scaled by the throughput of the path that reached it.
+    //With an AOV record, the first vertex's estimate counts as direct light and the rest as indirect.
+    glm::vec3 EstimateLight(Intersection isx, Ray r, unsigned int depth, AOVSample *aov = NULL);
 
-    bool RussianRoulette(const glm::vec3 &color,const int& depth);
+    //From rr_depth bounces on, a path survives with probability q, its throughput's largest channel clamped to
+    //[rr_min_survival, rr_max_survival], and a survivor's beta is divided by q so the estimate stays unbiased.
+    //Returns true when the path is terminated.
+    bool RussianRoulette(glm::vec3 &beta, unsigned int depth);
+    void SetRussianRoulette(unsigned int depth, float min_survival, float max_survival);
 
-    float throughput;
+    unsigned int rr_depth;
+    float rr_min_survival;
+    float rr_max_survival;
 
 protected:
     unsigned int max_depth;//Default value is 5.
+
+    //A thread's clone of the prototype, and which prototype it was cloned from
+    struct ThreadSamplerSlot
+    {
+        ThreadSamplerSlot(Sampler* s, unsigned int g) : sampler(s), generation(g) {}
+        ~ThreadSamplerSlot() {delete sampler;}
+        Sampler* sampler;
+        unsigned int generation;
+    };
+
+    Sampler* sampler;
+    std::atomic<unsigned int> sampler_generation;//Bumped by SetSampler
+    QThreadStorage<ThreadSamplerSlot*> thread_samplers;
+    QThreadStorage<AOVSample**> thread_aovs;//The storage owns the slot, not the record it points to
+    QThreadStorage<std::mt19937*> thread_generators;
 };
 
 class DirectLightingIntegrator : public Integrator
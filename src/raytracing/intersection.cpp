@@ -4,8 +4,7 @@
 Intersection::Intersection():
     point(glm::vec3(0)),
     normal(glm::vec3(0)),
-    tangent(glm::vec3(0)),
-    bitangent(glm::vec3(0)),
+    frame(),
     t(-1),
     texture_color(glm::vec3(1.0f))
 {
@@ -66,40 +65,6 @@ QList<Intersection> IntersectionEngine::GetAllIntersections(Ray r)
     return result;
 }
 
-glm::vec3 Intersection::ToLocalNormalCoordinate(const glm::vec3& w_world)
-{
-    glm::vec3 w_local;
-
-    glm::mat4 M;
-    M[0] = glm::vec4(tangent,0.0f);
-    M[1] = glm::vec4(bitangent,0.0f);
-    M[2] = glm::vec4(normal,0.0f);
-    M[3] = glm::vec4(0,0,0,1);
-
-    M = glm::transpose(M);
-
-    w_local = glm::vec3(M * glm::vec4(w_world, 0.0f));
-
-    return glm::normalize(w_local);
-}
-
-glm::vec3 Intersection::ToWorldNormalCoordinate(const glm::vec3& w_local)
-{
-    glm::vec3 w_world;
-
-    glm::mat4 M;
-    M[0] = glm::vec4(tangent,0.0f);
-    M[1] = glm::vec4(bitangent,0.0f);
-    M[2] = glm::vec4(normal,0.0f);
-    M[3] = glm::vec4(0,0,0,1);
-
-    //M = glm::transpose(M);
-
-    w_world = glm::vec3(M * glm::vec4(w_local, 0.0f));
-
-    return glm::normalize(w_world);
-}
-
 BVHNode::BVHNode()
 {
     left = NULL;
@@ -195,49 +160,53 @@ void BVHNode::releaseTree(BVHNode *root)
 
 Intersection BVHNode::getIntersection(const Ray &r)
 {
-    if(geometryAttached.size() < 1)
+    Geometry* hit = NULL;
+    GeometryHit found = getIntersectionT(r, hit);
+    if(hit == NULL)
         return Intersection();
+    return hit->ShadeIntersection(r, found);
+}
+
+GeometryHit BVHNode::getIntersectionT(const Ray &r, Geometry* &hit)
+{
+    hit = NULL;
+    if(geometryAttached.size() < 1)
+        return GeometryHit();
 
     Intersection intersection = bBox.getIntersection(r);
     if(intersection.t <= 0)
-        return Intersection();
+        return GeometryHit();
 
     if(left == NULL && right == NULL) // leaf
     {
         Geometry* g = geometryAttached[0];
-        //Ray transformedRay(r.GetTransformedCopy(g->transform.invT()));
-        //Intersection inter = g->GetIntersection(transformedRay);
-        Intersection inter = g->GetIntersection(r);
-        if(inter.t > 0)
+        GeometryHit found = g->GetIntersectionT(r);
+        if(found.t > 0)
         {
-            return inter;
+            hit = g;
+            return found;
         }
-        else
-            return Intersection();
+        return GeometryHit();
     }
 
-    Intersection leftInter, rightInter;
+    Geometry *leftHit = NULL, *rightHit = NULL;
+    GeometryHit leftFound, rightFound;
     if(left != NULL)
-        leftInter = left->getIntersection(r);
+        leftFound = left->getIntersectionT(r, leftHit);
     if(right != NULL)
-        rightInter = right->getIntersection(r);
+        rightFound = right->getIntersectionT(r, rightHit);
 
-    if(leftInter.t > 0 && rightInter.t > 0)
+    if(leftHit != NULL && (rightHit == NULL || leftFound.t < rightFound.t))
     {
-        if(leftInter.t < rightInter.t)
-            return leftInter;
-        else
-            return rightInter;
+        hit = leftHit;
+        return leftFound;
     }
-
-    if(leftInter.t <= 0 && rightInter.t > 0)
-        return rightInter;
-
-    if(leftInter.t > 0 && rightInter.t <= 0)
-        return leftInter;
-
-    if(leftInter.t <=0 && rightInter.t <= 0)
-        return Intersection();
+    if(rightHit != NULL)
+    {
+        hit = rightHit;
+        return rightFound;
+    }
+    return GeometryHit();
 }
 
 
@@ -1,5 +1,6 @@
 #pragma once
 #include <la.h>
+#include <raytracing/frame.h>
 #include <scene/geometry/geometry.h>
 #include <scene/geometry/bbox.h>
 
@@ -13,17 +14,28 @@ public:
 
     glm::vec3 point;      //The place at which the intersection occurred
     glm::vec3 normal;     //The surface normal at the point of intersection
-    glm::vec3 tangent;    //The surface tangent at the POI
-    glm::vec3 bitangent;  //The surface bitangent at the POI
+    Frame frame;          //The orthonormal tangent frame around normal. Always set through SetNormal so the two agree.
     float t;              //The parameterization for the ray (in world space) that generated this intersection.
                           //t is equal to the distance from the point of intersection to the ray's origin if the ray's direction is normalized.
     Geometry* object_hit; //The object that the ray intersected, or NULL if the ray hit nothing.
 
     glm::vec3 texture_color;
 
-    glm::vec3 ToLocalNormalCoordinate(const glm::vec3& w_world);
+    //Stores the world-space normal and builds the tangent frame around it once per hit
+    inline void SetNormal(const glm::vec3& n) {normal = n; frame = Frame(n);}
 
-    glm::vec3 ToWorldNormalCoordinate(const glm::vec3& w_local);
+    inline glm::vec3 ToLocalNormalCoordinate(const glm::vec3& w_world) const {return frame.ToLocal(w_world);}
+
+    inline glm::vec3 ToWorldNormalCoordinate(const glm::vec3& w_local) const {return frame.ToWorld(w_local);}
+};
+
+//What an intersect-only kernel found: enough to shade the hit later without searching for it again
+struct GeometryHit
+{
+    GeometryHit(float t = -1, Geometry* part = NULL) : t(t), part(part) {}
+
+    float t;//World-space t along the ray, -1 on a miss
+    Geometry* part;//For a shape made of others (a Mesh's triangles), the one that was hit; NULL otherwise
 };
 
 class BVHNode
@@ -47,7 +59,10 @@ public:
     static BVHNode* buildBVHTree(QList<Geometry*> objects);
     static void releaseTree(BVHNode* root);
 
+    //Finds the closest hit with the t-only kernels and shades only that one
     Intersection getIntersection(const Ray &r);
+    //Returns the closest hit (t of -1 on a miss) and the Geometry it belongs to, without shading anything
+    GeometryHit getIntersectionT(const Ray &r, Geometry* &hit);
 
     ~BVHNode(){}
 };
@@ -0,0 +1,220 @@
+#include <raytracing/lightsampler.h>
+#include <scene/geometry/geometry.h>
+#include <algorithm>
+
+LightSampler::LightSampler()
+{}
+
+void LightSampler::Clear()
+{
+    lights.clear();
+    light_index.clear();
+    alias_probability.clear();
+    alias.clear();
+    power_pdf.clear();
+    tree.clear();
+    leaf_of_light.clear();
+}
+
+float LightSampler::Power(const Geometry *light)
+{
+    glm::vec3 L = light->material->base_color * light->material->intensity;
+    return (L.x + L.y + L.z) / 3.0f * light->area;
+}
+
+void LightSampler::Build(const QList<Geometry *> &scene_lights)
+{
+    Clear();
+    lights = scene_lights;
+    int n = lights.size();
+    if(n == 0)
+        return;
+
+    float total = 0;
+    power_pdf.resize(n);
+    for(int i = 0; i < n; i++)
+    {
+        light_index.insert(lights[i], i);
+        power_pdf[i] = glm::max(0.0f, Power(lights[i]));
+        total += power_pdf[i];
+    }
+    //Lights with no measurable power are still picked, uniformly
+    for(int i = 0; i < n; i++)
+        power_pdf[i] = total > 0 ? power_pdf[i] / total : 1.0f / n;
+
+    //Vose's alias method: split the scaled probabilities into those below and above 1,
+    //then top up each small bucket with the remainder of a large one
+    alias_probability.resize(n);
+    alias.resize(n);
+    std::vector<float> scaled(n);
+    std::vector<int> small, large;
+    for(int i = 0; i < n; i++)
+    {
+        scaled[i] = power_pdf[i] * n;
+        if(scaled[i] < 1.0f)
+            small.push_back(i);
+        else
+            large.push_back(i);
+    }
+    while(!small.empty() && !large.empty())
+    {
+        int s = small.back(); small.pop_back();
+        int l = large.back(); large.pop_back();
+        alias_probability[s] = scaled[s];
+        alias[s] = l;
+        scaled[l] = (scaled[l] + scaled[s]) - 1.0f;
+        if(scaled[l] < 1.0f)
+            small.push_back(l);
+        else
+            large.push_back(l);
+    }
+    //Whatever is left is 1 up to rounding error
+    for(int i : large)
+    {
+        alias_probability[i] = 1.0f;
+        alias[i] = i;
+    }
+    for(int i : small)
+    {
+        alias_probability[i] = 1.0f;
+        alias[i] = i;
+    }
+
+    //Light tree
+    std::vector<int> order(n);
+    for(int i = 0; i < n; i++)
+        order[i] = i;
+    leaf_of_light.resize(n);
+    tree.reserve(2 * n - 1);
+    BuildTree(order, 0, n, -1);
+}
+
+int LightSampler::BuildTree(std::vector<int> &order, int begin, int end, int parent)
+{
+    int index = tree.size();
+    tree.push_back(LightTreeNode());
+    LightTreeNode node;
+    node.parent = parent;
+    node.left = node.right = node.light = -1;
+    node.power = 0;
+    node.minBounding = glm::vec3(INFINITY);
+    node.maxBounding = glm::vec3(-INFINITY);
+
+    glm::vec3 centroid_min(INFINITY), centroid_max(-INFINITY);
+    for(int i = begin; i < end; i++)
+    {
+        Geometry* g = lights[order[i]];
+        glm::vec3 minB = g->bBox != NULL ? g->bBox->minBounding : g->transform.position();
+        glm::vec3 maxB = g->bBox != NULL ? g->bBox->maxBounding : g->transform.position();
+        node.minBounding = glm::min(node.minBounding, minB);
+        node.maxBounding = glm::max(node.maxBounding, maxB);
+        node.power += power_pdf[order[i]];
+        centroid_min = glm::min(centroid_min, 0.5f * (minB + maxB));
+        centroid_max = glm::max(centroid_max, 0.5f * (minB + maxB));
+    }
+
+    if(end - begin == 1)
+    {
+        node.light = order[begin];
+        leaf_of_light[node.light] = index;
+        tree[index] = node;
+        return index;
+    }
+
+    //Median split along the widest axis of the centroids
+    glm::vec3 extent = centroid_max - centroid_min;
+    int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+    int middle = (begin + end) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+                     [this, axis](int a, int b)
+    {
+        Geometry* ga = lights[a];
+        Geometry* gb = lights[b];
+        float ca = ga->bBox != NULL ? ga->bBox->minBounding[axis] + ga->bBox->maxBounding[axis] : 2.0f * ga->transform.position()[axis];
+        float cb = gb->bBox != NULL ? gb->bBox->minBounding[axis] + gb->bBox->maxBounding[axis] : 2.0f * gb->transform.position()[axis];
+        return ca < cb;
+    });
+
+    node.left = BuildTree(order, begin, middle, index);
+    node.right = BuildTree(order, middle, end, index);
+    tree[index] = node;
+    return index;
+}
+
+Geometry* LightSampler::Sample(float u, float &pdf) const
+{
+    int n = lights.size();
+    if(n == 0)
+    {
+        pdf = 0;
+        return NULL;
+    }
+    int i = glm::min(int(u * n), n - 1);
+    float v = u * n - i;
+    int chosen = v < alias_probability[i] ? i : alias[i];
+    pdf = power_pdf[chosen];
+    return lights[chosen];
+}
+
+float LightSampler::Pdf(const Geometry *light) const
+{
+    int i = light_index.value(light, -1);
+    return i < 0 ? 0.0f : power_pdf[i];
+}
+
+float LightSampler::Importance(const LightTreeNode &node, const glm::vec3 &p) const
+{
+    glm::vec3 center = 0.5f * (node.minBounding + node.maxBounding);
+    float radius2 = 0.25f * glm::length2(node.maxBounding - node.minBounding);
+    return node.power / glm::max(glm::distance2(p, center), glm::max(radius2, 1e-6f));
+}
+
+float LightSampler::ChildProbability(int child, const glm::vec3 &p) const
+{
+    const LightTreeNode &parent = tree[tree[child].parent];
+    float wl = Importance(tree[parent.left], p);
+    float wr = Importance(tree[parent.right], p);
+    if(wl + wr <= 0)
+        return 0.5f;
+    return (child == parent.left ? wl : wr) / (wl + wr);
+}
+
+Geometry* LightSampler::Sample(const glm::vec3 &p, float u, float &pdf) const
+{
+    if(tree.empty())
+    {
+        pdf = 0;
+        return NULL;
+    }
+    pdf = 1.0f;
+    int index = 0;
+    while(tree[index].light < 0)
+    {
+        float pl = ChildProbability(tree[index].left, p);
+        //Rescale u into [0,1) for the level below
+        if(u < pl)
+        {
+            u = u / pl;
+            pdf *= pl;
+            index = tree[index].left;
+        }
+        else
+        {
+            u = glm::min((u - pl) / (1.0f - pl), 0.99999994f);
+            pdf *= 1.0f - pl;
+            index = tree[index].right;
+        }
+    }
+    return lights[tree[index].light];
+}
+
+float LightSampler::Pdf(const glm::vec3 &p, const Geometry *light) const
+{
+    int i = light_index.value(light, -1);
+    if(i < 0)
+        return 0.0f;
+    float pdf = 1.0f;
+    for(int index = leaf_of_light[i]; tree[index].parent >= 0; index = tree[index].parent)
+        pdf *= ChildProbability(index, p);
+    return pdf;
+}
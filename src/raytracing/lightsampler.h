@@ -0,0 +1,58 @@
+#pragma once
+#include <la.h>
+#include <QList>
+#include <QHash>
+#include <vector>
+
+class Geometry;
+
+//Picks one light out of the scene's lights so an estimator costs the same no matter how many lights there are.
+//Dividing the chosen light's contribution by the returned pdf gives an unbiased estimate of the sum over all lights.
+//Two distributions are kept:
+//  - a power distribution (alias table, O(1) per sample) for when there is no shading point, e.g. emitting light paths
+//  - a light tree over the lights' bounding boxes that favors bright lights near the shading point
+class LightSampler
+{
+public:
+    LightSampler();
+
+    //Called once the scene's lights have their materials, areas and bounding boxes
+    void Build(const QList<Geometry*> &lights);
+    void Clear();
+
+    //Power-proportional selection. pdf is the discrete probability of the returned light.
+    Geometry* Sample(float u, float &pdf) const;
+    float Pdf(const Geometry* light) const;
+
+    //Selection for a shading point p by descending the light tree. u is reused at each level.
+    Geometry* Sample(const glm::vec3 &p, float u, float &pdf) const;
+    float Pdf(const glm::vec3 &p, const Geometry* light) const;
+
+    static float Power(const Geometry* light);
+
+private:
+    struct LightTreeNode
+    {
+        glm::vec3 minBounding, maxBounding;
+        float power;
+        int left, right, parent;
+        int light;//Index into lights for a leaf, -1 otherwise
+    };
+
+    int BuildTree(std::vector<int> &order, int begin, int end, int parent);
+    //Rough contribution of a subtree to p: its power over the squared distance to its box, clamped inside the box
+    float Importance(const LightTreeNode &node, const glm::vec3 &p) const;
+    //Probability of stepping into child from its parent at p
+    float ChildProbability(int child, const glm::vec3 &p) const;
+
+    QList<Geometry*> lights;
+    QHash<const Geometry*, int> light_index;
+
+    //Alias table (Vose's method) over the lights' power
+    std::vector<float> alias_probability;
+    std::vector<int> alias;
+    std::vector<float> power_pdf;
+
+    std::vector<LightTreeNode> tree;
+    std::vector<int> leaf_of_light;
+};
@@ -10,11 +10,12 @@ Ray::Ray(const glm::vec4 &o, const glm::vec4 &d):
     Ray(glm::vec3(o), glm::vec3(d))
 {}
 
+//Copies verbatim. The direction was already normalized (or deliberately left unnormalized) by whoever built r.
 Ray::Ray(const Ray &r):
-    Ray(r.origin, r.direction)
-{
-    transmitted_color = r.transmitted_color;
-}
+    origin(r.origin),
+    direction(r.direction),
+    transmitted_color(r.transmitted_color)
+{}
 
 Ray::Ray():
     origin(0),
@@ -32,3 +33,12 @@ Ray Ray::GetTransformedCopy(const glm::mat4 &T) const
 
     return Ray(o, d);
 }
+
+Ray Ray::GetAffineTransformedCopy(const glm::mat4x3 &T) const
+{
+    Ray result;
+    result.origin = T * glm::vec4(origin, 1);
+    result.direction = T * glm::vec4(direction, 0);
+    result.transmitted_color = transmitted_color;
+    return result;
+}
@@ -13,6 +13,10 @@ public:
     //by the input transformation matrix.
     Ray GetTransformedCopy(const glm::mat4& T) const;
 
+    //Return a copy of this ray transformed by the input 3x4 affine matrix.
+    //The direction is NOT renormalized, so a t found against the copy is also the t of this ray.
+    Ray GetAffineTransformedCopy(const glm::mat4x3& T) const;
+
     glm::vec3 origin;
     glm::vec3 direction;
     glm::vec3 transmitted_color;
@@ -0,0 +1,78 @@
+#include <raytracing/samplers/haltonsampler.h>
+
+static const unsigned int primes[HaltonSampler::MAX_DIMENSION] =
+{
+    2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+    59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131,
+    137, 139, 149, 151, 157, 163, 167, 173, 179, 181, 191, 193, 197, 199, 211, 223,
+    227, 229, 233, 239, 241, 251, 257, 263, 269, 271, 277, 281, 283, 293, 307, 311
+};
+
+HaltonSampler::HaltonSampler(unsigned int seed):
+    Sampler(seed)
+{}
+
+Sampler* HaltonSampler::Clone() const
+{
+    return new HaltonSampler(seed);
+}
+
+//Kensler's hashed permutation of [0, l): element i of the permutation selected by p
+static unsigned int Permute(unsigned int i, unsigned int l, unsigned int p)
+{
+    unsigned int w = l - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+    do
+    {
+        i ^= p; i *= 0xe170893du;
+        i ^= p >> 16;
+        i ^= (i & w) >> 4;
+        i ^= p >> 8; i *= 0x0929eb3fu;
+        i ^= p >> 23;
+        i ^= (i & w) >> 1; i *= 1 | p >> 27;
+        i *= 0x6935fa69u;
+        i ^= (i & w) >> 11; i *= 0x74dcb303u;
+        i ^= (i & w) >> 2; i *= 0x9e501cc3u;
+        i ^= (i & w) >> 2; i *= 0xc860a3dfu;
+        i &= w;
+        i ^= i >> 5;
+    }
+    while(i >= l);
+    return (i + p) % l;
+}
+
+float HaltonSampler::ScrambledRadicalInverse(unsigned int base, unsigned int index, unsigned int hash) const
+{
+    //Enough digits that the ones left out are below float precision
+    float inv_base = 1.0f / base;
+    float scale = inv_base;
+    float result = 0;
+    unsigned int prefix = hash;
+    while(scale > 1e-7f)
+    {
+        unsigned int digit = index % base;
+        index /= base;
+        //Each digit's permutation depends on the digits before it, so the scrambling is nested like Owen's
+        unsigned int scrambled = Permute(digit, base, Hash(prefix));
+        prefix = Hash(prefix ^ (digit + 1));
+        result += scrambled * scale;
+        scale *= inv_base;
+    }
+    return glm::min(result, 0.99999994f);
+}
+
+float HaltonSampler::Sample1D(unsigned int d) const
+{
+    if(d >= MAX_DIMENSION)
+        return ToUnitFloat(Hash(DimensionHash(d) ^ Hash(state.index)));
+    return ScrambledRadicalInverse(primes[d], state.index, DimensionHash(d));
+}
+
+glm::vec2 HaltonSampler::Sample2D(unsigned int d) const
+{
+    return glm::vec2(Sample1D(d), Sample1D(d + 1));
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <raytracing/samplers/sampler.h>
+
+//Radical inverses of the sample index in the first prime bases, one base per dimension, with every digit put through
+//a random permutation that depends on the pixel, the dimension and the digits above it (a nested, Owen-style scrambling).
+//Dimensions past the prime table fall back to independent values.
+class HaltonSampler : public Sampler
+{
+public:
+    HaltonSampler(unsigned int seed = 0);
+    virtual Sampler* Clone() const;
+    virtual const char* Name() const {return "halton";}
+
+    static const unsigned int MAX_DIMENSION = 64;
+
+protected:
+    virtual float Sample1D(unsigned int d) const;
+    virtual glm::vec2 Sample2D(unsigned int d) const;
+
+private:
+    float ScrambledRadicalInverse(unsigned int base, unsigned int index, unsigned int hash) const;
+};
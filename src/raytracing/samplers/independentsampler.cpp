@@ -0,0 +1,20 @@
+#include <raytracing/samplers/independentsampler.h>
+
+IndependentSampler::IndependentSampler(unsigned int seed):
+    Sampler(seed)
+{}
+
+Sampler* IndependentSampler::Clone() const
+{
+    return new IndependentSampler(seed);
+}
+
+float IndependentSampler::Sample1D(unsigned int d) const
+{
+    return ToUnitFloat(Hash(DimensionHash(d) ^ Hash(state.index)));
+}
+
+glm::vec2 IndependentSampler::Sample2D(unsigned int d) const
+{
+    return glm::vec2(Sample1D(d), Sample1D(d + 1));
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <raytracing/samplers/sampler.h>
+
+//Uncorrelated values in every dimension, like drawing from a uniform_real_distribution
+class IndependentSampler : public Sampler
+{
+public:
+    IndependentSampler(unsigned int seed = 0);
+    virtual Sampler* Clone() const;
+    virtual const char* Name() const {return "independent";}
+
+protected:
+    virtual float Sample1D(unsigned int d) const;
+    virtual glm::vec2 Sample2D(unsigned int d) const;
+};
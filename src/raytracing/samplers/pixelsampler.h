@@ -1,17 +1,38 @@
 #pragma once
 #include <la.h>
-#include <QList>
 #include <random>
 
+//Screen-space sample positions within a pixel. Nothing here allocates: samples are produced one at a time or
+//written into a buffer the caller owns, so the per-pixel loop can reuse the same storage for the whole image.
 class PixelSampler
 {
 protected:
     int samples_sqrt;//The square root of how many samples to take within the given pixel.
                     //In other words, when samples_sqrt = 5, 25 samples will be taken in the pixel
+    int pixel_x, pixel_y;//The pixel Next is walking through
+    unsigned int next_index;
 public:
-    PixelSampler():samples_sqrt(1){}
-    PixelSampler(int samples):samples_sqrt(samples){}
+    PixelSampler():PixelSampler(1){}
+    PixelSampler(int samples):samples_sqrt(samples), pixel_x(0), pixel_y(0), next_index(0){}
     void SetSampleCount(int samples){samples_sqrt = samples;}
     virtual ~PixelSampler(){}
-    virtual QList<glm::vec2> GetSamples(int x, int y) = 0;
+
+    unsigned int SampleCount() const {return samples_sqrt * samples_sqrt;}
+
+    //Screen position of sample index of pixel (x, y). Indices past SampleCount() go around the pixel's strata again.
+    virtual glm::vec2 GetSample(int x, int y, unsigned int index) = 0;
+
+    //Writes the first min(capacity, SampleCount()) samples of pixel (x, y) to samples and returns how many were written
+    unsigned int GetSamples(int x, int y, glm::vec2* samples, unsigned int capacity)
+    {
+        unsigned int count = glm::min(capacity, SampleCount());
+        for(unsigned int i = 0; i < count; i++)
+            samples[i] = GetSample(x, y, i);
+        return count;
+    }
+
+    //Generator style: after StartPixel, each Next returns the pixel's next sample.
+    //A progressive renderer can keep calling Next for one more sample per pass.
+    void StartPixel(int x, int y) {pixel_x = x; pixel_y = y; next_index = 0;}
+    glm::vec2 Next() {return GetSample(pixel_x, pixel_y, next_index++);}
 };
@@ -0,0 +1,41 @@
+#include <raytracing/samplers/sampler.h>
+
+Sampler::Sampler(unsigned int seed):
+    seed(seed)
+{}
+
+void Sampler::StartPixelSample(const glm::ivec2 &pixel, unsigned int index)
+{
+    state.pixel = pixel;
+    state.index = index;
+    state.dimension = 0;
+}
+
+float Sampler::Get1D()
+{
+    return Sample1D(state.dimension++);
+}
+
+glm::vec2 Sampler::Get2D()
+{
+    glm::vec2 u = Sample2D(state.dimension);
+    state.dimension += 2;
+    return u;
+}
+
+//Chris Wellons' lowbias32
+unsigned int Sampler::Hash(unsigned int x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+unsigned int Sampler::DimensionHash(unsigned int d) const
+{
+    unsigned int h = Hash(seed ^ Hash(state.pixel.x ^ Hash(state.pixel.y)));
+    return Hash(h ^ Hash(d + 0x9e3779b9u));
+}
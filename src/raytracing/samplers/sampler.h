@@ -0,0 +1,52 @@
+#pragma once
+#include <la.h>
+
+//Which sample a Sampler is on: the pixel, the sample's index within the pixel and the next dimension to hand out
+struct SamplerState
+{
+    SamplerState(): pixel(0), index(0), dimension(0) {}
+    glm::ivec2 pixel;
+    unsigned int index;
+    unsigned int dimension;
+};
+
+//Hands out the values in [0,1) that a camera sample consumes, one dimension at a time:
+//the film position, the lens, then every light and BxDF sample along the path.
+//Each value is a pure function of (seed, pixel, sample index, dimension), so subclasses can spread the samples of
+//one pixel evenly in every dimension, and a sample can be resumed from its SamplerState on any thread.
+class Sampler
+{
+public:
+    Sampler(unsigned int seed);
+    virtual ~Sampler(){}
+
+    //Starts sample index of pixel at dimension 0
+    void StartPixelSample(const glm::ivec2 &pixel, unsigned int index);
+    const SamplerState &State() const {return state;}
+    void SetState(const SamplerState &s) {state = s;}
+
+    //The next one or two dimensions of the current sample
+    float Get1D();
+    glm::vec2 Get2D();
+
+    //A sampler of the same type and seed with its own state, for another thread
+    virtual Sampler* Clone() const = 0;
+    //Type and seed pin down every value the sampler hands out, so they are all a checkpoint needs to continue a render
+    virtual const char* Name() const = 0;
+    unsigned int Seed() const {return seed;}
+
+protected:
+    //Value of dimension d of the current sample, and of dimensions d and d + 1 as a pair
+    virtual float Sample1D(unsigned int d) const = 0;
+    virtual glm::vec2 Sample2D(unsigned int d) const = 0;
+
+    //Hash of the seed, the current pixel and d, to decorrelate pixels and dimensions from each other
+    unsigned int DimensionHash(unsigned int d) const;
+
+    static unsigned int Hash(unsigned int x);
+    //Maps the top 24 bits of x to [0,1)
+    static float ToUnitFloat(unsigned int x) {return (x >> 8) * (1.0f / 16777216.0f);}
+
+    unsigned int seed;
+    SamplerState state;
+};
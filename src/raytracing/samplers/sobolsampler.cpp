@@ -0,0 +1,61 @@
+#include <raytracing/samplers/sobolsampler.h>
+
+SobolSampler::SobolSampler(unsigned int seed):
+    Sampler(seed)
+{}
+
+Sampler* SobolSampler::Clone() const
+{
+    return new SobolSampler(seed);
+}
+
+unsigned int SobolSampler::ReverseBits(unsigned int x)
+{
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+    x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+    x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+    x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+    return x;
+}
+
+unsigned int SobolSampler::OwenScramble(unsigned int x, unsigned int seed)
+{
+    x = ReverseBits(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return ReverseBits(x);
+}
+
+unsigned int SobolSampler::Sobol(unsigned int index, unsigned int dimension)
+{
+    //Dimension 0 is the van der Corput sequence. Dimension 1 has the direction numbers of x + 1,
+    //each the previous one xor itself shifted right by one.
+    unsigned int result = 0;
+    unsigned int v = 0x80000000u;
+    for(; index != 0; index >>= 1)
+    {
+        if(index & 1)
+            result ^= v;
+        v = dimension == 0 ? v >> 1 : v ^ (v >> 1);
+    }
+    return result;
+}
+
+float SobolSampler::Sample1D(unsigned int d) const
+{
+    unsigned int h = DimensionHash(d);
+    unsigned int index = OwenScramble(state.index, h);
+    return ToUnitFloat(OwenScramble(Sobol(index, 0), Hash(h ^ 0x68bc21ebu)));
+}
+
+glm::vec2 SobolSampler::Sample2D(unsigned int d) const
+{
+    unsigned int h = DimensionHash(d);
+    unsigned int index = OwenScramble(state.index, h);
+    return glm::vec2(ToUnitFloat(OwenScramble(Sobol(index, 0), Hash(h ^ 0x68bc21ebu))),
+                     ToUnitFloat(OwenScramble(Sobol(index, 1), Hash(h ^ 0x02e5be93u))));
+}
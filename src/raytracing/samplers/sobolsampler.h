@@ -0,0 +1,25 @@
+#pragma once
+#include <raytracing/samplers/sampler.h>
+
+//Owen-scrambled Sobol points, padded to any number of dimensions (Burley 2020, "Practical Hash-based Owen Scrambling").
+//Each 1D or 2D sample uses the first two Sobol dimensions. Their sample order is shuffled per pixel and dimension,
+//and each point is given its own Owen scrambling, so that dimensions do not correlate with each other.
+//Within a dimension pair the first 2^k samples of a pixel are stratified in every elementary interval of area 2^-k,
+//the same guarantee a PMJ02 sequence gives.
+class SobolSampler : public Sampler
+{
+public:
+    SobolSampler(unsigned int seed = 0);
+    virtual Sampler* Clone() const;
+    virtual const char* Name() const {return "sobol";}
+
+protected:
+    virtual float Sample1D(unsigned int d) const;
+    virtual glm::vec2 Sample2D(unsigned int d) const;
+
+private:
+    static unsigned int ReverseBits(unsigned int x);
+    //Laine and Karras' hash-based Owen scrambling, applied to bit-reversed values
+    static unsigned int OwenScramble(unsigned int x, unsigned int seed);
+    static unsigned int Sobol(unsigned int index, unsigned int dimension);
+};
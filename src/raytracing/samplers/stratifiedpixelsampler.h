@@ -7,7 +7,8 @@ class StratifiedPixelSampler : public PixelSampler
 public:
     StratifiedPixelSampler();
     StratifiedPixelSampler(unsigned int samples, unsigned int seed);
-    virtual QList<glm::vec2> GetSamples(int x, int y);
+    //A jittered position in stratum index % SampleCount() of the pixel's samples_sqrt x samples_sqrt grid
+    virtual glm::vec2 GetSample(int x, int y, unsigned int index);
 
 protected:
     std::mt19937 mersenne_generator;
@@ -6,19 +6,13 @@ UniformPixelSampler::UniformPixelSampler():PixelSampler()
 UniformPixelSampler::UniformPixelSampler(int samples):PixelSampler(samples)
 {}
 
-QList<glm::vec2> UniformPixelSampler::GetSamples(int x, int y)
+glm::vec2 UniformPixelSampler::GetSample(int x, int y, unsigned int index)
 {
-    QList<glm::vec2> result;
-    //1. Divide the given pixel into subsections
-    for(float i = 0; i < samples_sqrt; i++)
-    {
-        for(float j = 0; j < samples_sqrt; j++)
-        {
-            //Get a random sample within the sub-pixel square
-            float dx = x + i/samples_sqrt;
-            float dy = y + j/samples_sqrt;
-            result.append(glm::vec2(dx, dy));
-        }
-    }
-    return result;
+    //Divide the given pixel into subsections
+    unsigned int stratum = index % SampleCount();
+    float i = stratum / samples_sqrt;
+    float j = stratum % samples_sqrt;
+    float dx = x + i/samples_sqrt;
+    float dy = y + j/samples_sqrt;
+    return glm::vec2(dx, dy);
 }
@@ -7,5 +7,6 @@ public:
     UniformPixelSampler();
     UniformPixelSampler(int samples);
 
-    virtual QList<glm::vec2> GetSamples(int x, int y);
+    //The corner of subsection index % SampleCount() of the pixel's samples_sqrt x samples_sqrt grid
+    virtual glm::vec2 GetSample(int x, int y, unsigned int index);
 };
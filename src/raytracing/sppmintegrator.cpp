@@ -0,0 +1,193 @@
+#include <raytracing/sppmintegrator.h>
+#include <cmath>
+
+SPPMIntegrator::SPPMIntegrator():
+    base_radius(-1),
+    radius_alpha(0.7f),
+    photon_path_count(20000),
+    max_photons(100000),
+    samples_per_pass(1024)
+{}
+
+void SPPMIntegrator::SetPhotonRadius(float r)
+{
+    base_radius = r;
+}
+
+void SPPMIntegrator::SetRadiusAlpha(float alpha)
+{
+    radius_alpha = glm::clamp(alpha, 0.0f, 1.0f);
+}
+
+void SPPMIntegrator::SetPhotonPathCount(int count)
+{
+    photon_path_count = glm::max(count, 1);
+}
+
+void SPPMIntegrator::SetMaxPhotons(int count)
+{
+    max_photons = glm::max(count, 1);
+}
+
+void SPPMIntegrator::SetSamplesPerPass(int count)
+{
+    samples_per_pass = glm::max(count, 1);
+}
+
+void SPPMIntegrator::TracePhoton(std::vector<Photon> &photons)
+{
+    float selectPdf;
+    Geometry* light = scene->light_sampler.Sample(GetUniform(), selectPdf);
+    if(light == NULL || selectPdf <= 0 || light->area <= 0)
+        return;
+    Intersection origin = light->RandomSampleOnSurface(GetUniform(), GetUniform());
+    if(origin.object_hit == NULL)
+        return;
+    origin.object_hit = light;
+
+    //Cosine-weighted emission: Le cos / (pdf_light pdf_area pdf_dir) = Le pi area / pdf_light
+    float costheta = glm::sqrt(GetUniform());
+    float sintheta = glm::sqrt(glm::max(0.0f, 1.0f - costheta*costheta));
+    float phi = GetUniform() * TWO_PI;
+    glm::vec3 dir = origin.ToWorldNormalCoordinate(glm::vec3(sintheta * glm::cos(phi), sintheta * glm::sin(phi), costheta));
+    float pdf;
+    glm::vec3 power = light->material->EvaluateScatteredEnergy(origin, dir, dir, pdf) * PI * light->area / selectPdf;
+    Ray r(origin.point + 1e-3f * origin.normal, dir);
+
+    for(unsigned int bounce = 0; bounce < max_depth; bounce++)
+    {
+        Intersection isx = intersection_engine->GetIntersection(r);
+        if(isx.t <= 0 || isx.object_hit->material->is_light_source)
+            break;
+
+        //Drawn from the thread's seeded generator, not the material's own, so a pass repeats from its seed
+        glm::vec3 wo_local = isx.ToLocalNormalCoordinate(-r.direction);
+        glm::vec3 wi_local;
+        float u0 = GetUniform();
+        float u1 = GetUniform();
+        float u2 = GetUniform();
+        glm::vec3 F = isx.object_hit->material->SampleAndEvaluateScatteredEnergy(isx, wo_local, wi_local, u0, u1, u2, pdf);
+
+        //Photons only stay where a camera ray can gather them, on surfaces with a non-delta lobe
+        if(isx.object_hit->material->HasNonDelta())
+        {
+            if(int(photons.size()) >= max_photons)
+                return;
+            Photon p;
+            p.position = isx.point;
+            p.wi = -r.direction;
+            p.power = power;
+            photons.push_back(p);
+        }
+
+        if(pdf == 0 || (F.x == 0 && F.y == 0 && F.z == 0))
+            break;
+        glm::vec3 wi = isx.ToWorldNormalCoordinate(wi_local);
+        //Delta lobes return F already divided by their pdf
+        power *= isinf(pdf) ? F : F * glm::abs(glm::dot(wi, isx.normal)) / pdf;
+        r = Ray(isx.point + glm::sign(glm::dot(wi, isx.normal)) * isx.normal * 1e-3f, wi);
+    }
+}
+
+float SPPMIntegrator::PhotonRadius(unsigned int sample_index) const
+{
+    float r = base_radius;
+    if(r <= 0)
+    {
+        glm::vec3 extent = intersection_engine->root->bBox.getMaxBoudning() - intersection_engine->root->bBox.getMinBounding();
+        r = 0.005f * glm::length(extent);
+    }
+    //r_i^2 = r_0^2 prod_{k=1..i} (k + alpha) / (k + 1), written with gamma functions so any pass's radius costs the same
+    float i = float(sample_index);
+    return r * glm::sqrt(std::exp(std::lgamma(i + 1 + radius_alpha) - std::lgamma(1 + radius_alpha) - std::lgamma(i + 2)));
+}
+
+void SPPMIntegrator::BeginPass(Pass *pass)
+{
+    //Storage never grows past the cap, so a pass costs the same memory however bright or enclosed the scene is
+    std::vector<Photon> unsorted;
+    unsorted.reserve(max_photons);
+    pass->emitted = 0;
+    while(pass->emitted < photon_path_count && int(unsorted.size()) < max_photons)
+    {
+        TracePhoton(unsorted);
+        pass->emitted++;
+    }
+
+    std::vector<glm::vec3> positions(unsorted.size());
+    for(unsigned int i = 0; i < unsorted.size(); i++)
+        positions[i] = unsorted[i].position;
+    pass->grid.Build(positions, pass->grid_radius);
+    pass->photons.resize(unsorted.size());
+    for(unsigned int k = 0; k < unsorted.size(); k++)
+        pass->photons[k] = unsorted[pass->grid.Order()[k]];
+    pass->samples = 0;
+}
+
+glm::vec3 SPPMIntegrator::TraceRay(Ray r, unsigned int depth)
+{
+    if(!passes.hasLocalData())
+    {
+        Pass *pass = new Pass();
+        pass->radius = 0;
+        pass->grid_radius = 0;
+        pass->emitted = 0;
+        pass->samples = samples_per_pass;
+        passes.setLocalData(pass);
+    }
+    Pass *pass = passes.localData();
+    pass->radius = PhotonRadius(ThreadSampler()->State().index);
+    //A thread starts on the earliest samples of its pixels, so the grid is rarely too fine for one
+    if(pass->radius > pass->grid_radius)
+    {
+        pass->grid_radius = pass->radius;
+        pass->samples = samples_per_pass;
+    }
+    if(pass->samples >= samples_per_pass)
+        BeginPass(pass);
+    pass->samples++;
+
+    //Gather the photons at every surface with a non-delta lobe and follow specular bounces past it.
+    //The gather covers all of the non-delta lobes, so a path that samples one of them ends there; picking a
+    //delta lobe with its own probability keeps the specular part unbiased.
+    glm::vec3 L(0);
+    glm::vec3 beta(1.0f);
+    float pdf;
+    for(; depth < max_depth; depth++)
+    {
+        Intersection isx = intersection_engine->GetIntersection(r);
+        if(isx.t <= 0)
+            break;
+        if(isx.object_hit->material->is_light_source)
+        {
+            if(depth == 0)
+                return isx.object_hit->material->base_color * isx.texture_color;
+            L += beta * isx.object_hit->material->EvaluateScatteredEnergy(isx, -r.direction, -r.direction, pdf);
+            break;
+        }
+
+        glm::vec3 wo_local = isx.ToLocalNormalCoordinate(-r.direction);
+        if(isx.object_hit->material->HasNonDelta() && pass->emitted > 0)
+        {
+            //Density estimate with a constant kernel over the disc of the current radius
+            glm::vec3 gathered(0);
+            pass->grid.Query(isx.point, pass->radius, pass->neighbours);
+            for(int n : pass->neighbours)
+            {
+                const Photon &p = pass->photons[n];
+                float photon_pdf;
+                gathered += p.power * isx.object_hit->material->EvaluateScatteredEnergy(isx, wo_local, isx.ToLocalNormalCoordinate(p.wi), photon_pdf);
+            }
+            L += beta * gathered / (PI * pass->radius * pass->radius * pass->emitted);
+        }
+
+        glm::vec3 wi_local;
+        glm::vec3 F = SampleBSDF(isx, wo_local, wi_local, pdf);
+        if(!isinf(pdf) || (F.x == 0 && F.y == 0 && F.z == 0))
+            break;
+        glm::vec3 wi = isx.ToWorldNormalCoordinate(wi_local);
+        beta *= F;
+        r = Ray(isx.point + glm::sign(glm::dot(wi, isx.normal)) * isx.normal * 1e-3f, wi);
+    }
+    return L;
+}
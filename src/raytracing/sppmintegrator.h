@@ -0,0 +1,59 @@
+#pragma once
+#include <la.h>
+#include <raytracing/integrator.h>
+#include <raytracing/hashgrid.h>
+#include <QThreadStorage>
+
+//Stochastic progressive photon mapping, in the form of Knaus and Zwicker 2011 ("Progressive Photon Mapping:
+//A Probabilistic Approach"): every pass traces a fresh photon map and estimates radiance with a kernel radius
+//that shrinks from pass to pass, so averaging the passes converges without per-pixel statistics.
+//Camera rays follow specular bounces to the first non-specular surface and gather the photons around it,
+//which resolves caustics that connections from a diffuse surface cannot.
+//Each render thread runs its own passes, so photon maps are traced and their grids built in parallel with no sharing.
+//The radius a camera sample gathers with follows its index within the pixel, so it keeps shrinking however the samples
+//are split among render passes, threads, resumed checkpoints or headless leases.
+class SPPMIntegrator : public Integrator
+{
+public:
+    SPPMIntegrator();
+
+    virtual glm::vec3 TraceRay(Ray r, unsigned int depth);
+
+    void SetPhotonRadius(float r);//A radius <= 0 picks one from the scene's size
+    void SetRadiusAlpha(float alpha);
+    void SetPhotonPathCount(int count);
+    void SetMaxPhotons(int count);
+    void SetSamplesPerPass(int count);
+
+private:
+    struct Photon
+    {
+        glm::vec3 position;
+        glm::vec3 wi;//World direction the photon arrived from
+        glm::vec3 power;
+    };
+
+    struct Pass
+    {
+        float radius;//The current camera sample's
+        float grid_radius;//The largest radius a sample of this thread has gathered with, which the grid is built for
+        int emitted;//Photon paths traced, which the density estimate is normalized by
+        int samples;//Camera samples that have used this pass
+        std::vector<Photon> photons;//In grid order
+        HashGrid grid;
+        std::vector<int> neighbours;//Query results, kept to avoid reallocating
+    };
+
+    //Traces the next pass's photons and rebuilds the grid over them
+    void BeginPass(Pass *pass);
+    void TracePhoton(std::vector<Photon> &photons);
+    //Radius of pass sample_index, as if every camera sample of a pixel were its own pass
+    float PhotonRadius(unsigned int sample_index) const;
+
+    float base_radius;
+    float radius_alpha;//Fraction of the photons kept from pass to pass: r_{i+1}^2 = r_i^2 (i + alpha) / (i + 1)
+    int photon_path_count;//Photon paths emitted per pass
+    int max_photons;//Photons stored per pass. Emission stops early once this many are stored.
+    int samples_per_pass;//Camera samples traced against one photon map before it is rebuilt
+    QThreadStorage<Pass*> passes;
+};
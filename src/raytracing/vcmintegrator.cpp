@@ -0,0 +1,147 @@
+#include <raytracing/vcmintegrator.h>
+
+VCMIntegrator::VCMIntegrator():
+    base_radius(-1),
+    radius_alpha(0.75f),
+    light_path_count(2048)
+{}
+
+void VCMIntegrator::SetMergeRadius(float r)
+{
+    base_radius = r;
+}
+
+void VCMIntegrator::SetRadiusAlpha(float alpha)
+{
+    radius_alpha = glm::clamp(alpha, 0.0f, 1.0f);
+}
+
+void VCMIntegrator::SetLightPathCount(int count)
+{
+    light_path_count = glm::max(count, 1);
+}
+
+float VCMIntegrator::MergeRatio(float pdfLight) const
+{
+    //Merging accepts any light node within the radius, so its density is the light subpath's times the disc area,
+    //once for each light subpath in the iteration
+    Iteration *it = iterations.localData();
+    if(it == NULL)
+        return 0;
+    return pdfLight * PI * it->radius * it->radius * it->lightPaths.size();
+}
+
+float VCMIntegrator::MergeRadius(unsigned int sample_index) const
+{
+    float r = base_radius;
+    if(r <= 0)
+    {
+        glm::vec3 extent = intersection_engine->root->bBox.getMaxBoudning() - intersection_engine->root->bBox.getMinBounding();
+        r = 0.0015f * glm::length(extent);
+    }
+    return r * glm::pow(float(sample_index + 1), 0.5f * (radius_alpha - 1.0f));
+}
+
+void VCMIntegrator::BeginIteration(Iteration *it)
+{
+    it->lightPaths.resize(light_path_count);
+    it->photons.clear();
+    std::vector<glm::vec3> positions;
+    for(int p = 0; p < light_path_count; p++)
+    {
+        it->lightPaths[p].clear();
+        float selectPdf;
+        Geometry* light = scene->light_sampler.Sample(GetUniform(), selectPdf);
+        if(light != NULL && selectPdf > 0)
+            it->lightPaths[p] = generateLightPath(light, selectPdf);
+
+        //The origin is only reached by sampling the light, and merges evaluate the eye node's non-delta lobes,
+        //so a photon is kept wherever those exist, whichever lobe the light subpath went on with
+        for(int j = 1; j < int(it->lightPaths[p].size()); j++)
+        {
+            const PathNode &q = it->lightPaths[p][j];
+            if(!q.connectable || q.on_light)
+                continue;
+            positions.push_back(q.isx.point);
+            it->photons.push_back(glm::ivec2(p, j));
+        }
+    }
+    it->grid.Build(positions, it->grid_radius);
+    std::vector<glm::ivec2> unsorted;
+    unsorted.swap(it->photons);
+    it->photons.resize(unsorted.size());
+    for(unsigned int k = 0; k < unsorted.size(); k++)
+        it->photons[k] = unsorted[it->grid.Order()[k]];
+    it->next = 0;
+}
+
+glm::vec3 VCMIntegrator::MergeSubpaths(std::vector<PathNode> &eyePath, Iteration *it)
+{
+    glm::vec3 result(0);
+    float normalization = 1.0f / (PI * it->radius * it->radius * it->lightPaths.size());
+    for(int t = 1; t <= int(eyePath.size()); t++)
+    {
+        PathNode &pt = eyePath[t-1];
+        if(!pt.connectable || pt.on_light)
+            continue;
+
+        it->grid.Query(pt.isx.point, it->radius, it->neighbours);
+        for(int n : it->neighbours)
+        {
+            std::vector<PathNode> &lightPath = it->lightPaths[it->photons[n].x];
+            int j = it->photons[n].y;
+            //The merged path is the light subpath up to the photon, ending where the eye subpath ends
+            if(j + t > int(max_depth))
+                continue;
+
+            PathNode &q = lightPath[j];
+            float pdf;
+            glm::vec3 f = pt.isx.object_hit->material->EvaluateScatteredEnergy(pt.isx, pt.dirIn_local,
+                                                                               pt.isx.ToLocalNormalCoordinate(q.dirIn_world), pdf);
+            glm::vec3 L = pt.beta * f * q.beta * normalization;
+            if(L.x == 0 && L.y == 0 && L.z == 0)
+                continue;
+
+            //Weighted as the connection of the same eye nodes to the light nodes before the photon, with pt merged instead
+            float mergeRatio = 0;
+            float sum = StrategyRatioSum(eyePath, t, lightPath, j, &mergeRatio);
+            result += L * (mergeRatio * mergeRatio / sum);
+        }
+    }
+    return result;
+}
+
+glm::vec3 VCMIntegrator::TraceRay(Ray r, unsigned int depth)
+{
+    if(!iterations.hasLocalData())
+    {
+        Iteration *it = new Iteration();
+        it->radius = 0;
+        it->grid_radius = 0;
+        it->next = 0;
+        iterations.setLocalData(it);
+    }
+    Iteration *it = iterations.localData();
+    //Set before the light subpath is splatted, since its weights depend on the radius too
+    it->radius = MergeRadius(ThreadSampler()->State().index);
+    //A thread starts on the earliest samples of its pixels, so the grid is rarely too fine for one
+    if(it->radius > it->grid_radius)
+    {
+        it->grid_radius = it->radius;
+        it->next = it->lightPaths.size();
+    }
+    if(it->next >= it->lightPaths.size())
+        BeginIteration(it);
+
+    std::vector<PathNode> &lightPath = it->lightPaths[it->next++];
+    SplatLightPath(lightPath);
+
+    std::vector<PathNode> eyePath = generateEyePath(r);
+    if(eyePath.empty())
+        return glm::vec3(0);
+    else if(eyePath[0].on_light)
+    {
+        return eyePath[0].isx.object_hit->material->base_color * eyePath[0].isx.texture_color;
+    }
+    return ConnectSubpaths(eyePath, lightPath) + MergeSubpaths(eyePath, it);
+}
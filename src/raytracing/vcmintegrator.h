@@ -0,0 +1,51 @@
+#pragma once
+#include <la.h>
+#include <raytracing/bidirectionalintegrator.h>
+#include <raytracing/hashgrid.h>
+#include <QThreadStorage>
+
+//Vertex connection and merging (Georgiev et al. 2012, "Light Transport Simulation with Vertex Connection and Merging").
+//Runs in iterations: each one traces a batch of light subpaths, keeps their nodes as photons in a hashed grid,
+//and pairs every camera sample with one of the subpaths for the BDPT connections. The camera sample is also merged
+//with every photon within the merge radius of each of its nodes, which finds specular-diffuse-specular paths that
+//no connection can. Merging and connecting are weighted together with the power heuristic.
+//Each render thread runs its own iterations, so photon sets are traced and their grids built in parallel with no sharing.
+//The merge radius follows the camera sample's index within the pixel, as if each sample of a pixel were its own iteration,
+//so it keeps shrinking however the samples are split among render passes, threads, resumed checkpoints or headless leases.
+class VCMIntegrator : public BidirectionalIntegrator
+{
+public:
+    VCMIntegrator();
+
+    virtual glm::vec3 TraceRay(Ray r, unsigned int depth);
+
+    void SetMergeRadius(float r);//A radius <= 0 picks one from the scene's size
+    void SetRadiusAlpha(float alpha);
+    void SetLightPathCount(int count);
+
+protected:
+    virtual float MergeRatio(float pdfLight) const;
+
+private:
+    struct Iteration
+    {
+        float radius;//The current camera sample's
+        float grid_radius;//The largest radius a sample of this thread has merged with, which the grid is built for
+        unsigned int next;//The light subpath the next camera sample is paired with
+        std::vector<std::vector<PathNode>> lightPaths;
+        std::vector<glm::ivec2> photons;//(light subpath, node) of each point in grid, in grid order
+        HashGrid grid;
+        std::vector<int> neighbours;//Query results, kept to avoid reallocating
+    };
+
+    //Traces the next batch of light subpaths and rebuilds the grid over their nodes
+    void BeginIteration(Iteration *it);
+    float MergeRadius(unsigned int sample_index) const;
+    //Weighted sum of merging each eye node with the photons around it
+    glm::vec3 MergeSubpaths(std::vector<PathNode> &eyePath, Iteration *it);
+
+    float base_radius;
+    float radius_alpha;//The radius shrinks as (index + 1)^((alpha - 1) / 2), so that bias vanishes over iterations
+    int light_path_count;
+    QThreadStorage<Iteration*> iterations;
+};
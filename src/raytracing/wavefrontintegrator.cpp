@@ -0,0 +1,281 @@
+#include <raytracing/wavefrontintegrator.h>
+#include <algorithm>
+
+WavefrontIntegrator::WavefrontIntegrator():
+    queue_size(4096)
+{}
+
+void WavefrontIntegrator::SetQueueSize(unsigned int size)
+{
+    queue_size = glm::max(size, 1u);
+}
+
+void WavefrontIntegrator::PathQueue::Resize(unsigned int n)
+{
+    origin.resize(n);
+    direction.resize(n);
+    beta.resize(n);
+    depth.resize(n);
+    pixel.resize(n);
+    sample.resize(n);
+    found.resize(n);
+    hit.resize(n);
+}
+
+void WavefrontIntegrator::PathQueue::Copy(unsigned int from, PathQueue &to, unsigned int slot) const
+{
+    to.origin[slot] = origin[from];
+    to.direction[slot] = direction[from];
+    to.beta[slot] = beta[from];
+    to.depth[slot] = depth[from];
+    to.pixel[slot] = pixel[from];
+    to.sample[slot] = sample[from];
+}
+
+void WavefrontIntegrator::ShadowQueue::Clear()
+{
+    origin.clear();
+    direction.clear();
+    contribution.clear();
+    light.clear();
+    pixel.clear();
+    needs_emission.clear();
+    depth.clear();
+}
+
+void WavefrontIntegrator::ShadowQueue::Push(const Ray &r, const glm::vec3 &c, Geometry *l, int p, bool emission, unsigned int d)
+{
+    origin.push_back(r.origin);
+    direction.push_back(r.direction);
+    contribution.push_back(c);
+    light.push_back(l);
+    pixel.push_back(p);
+    needs_emission.push_back(emission);
+    depth.push_back(d);
+}
+
+glm::vec3 WavefrontIntegrator::TraceRay(Ray r, unsigned int depth)
+{
+    std::vector<Ray> rays(1, r);
+    std::vector<glm::vec3> colors;
+    TraceRays(rays, std::vector<SamplerState>(), colors);
+    return colors[0];
+}
+
+void WavefrontIntegrator::Intersect(PathQueue &paths, unsigned int count)
+{
+    for(unsigned int i = 0; i < count; i++)
+        paths.found[i] = intersection_engine->root->getIntersectionT(Ray(paths.origin[i], paths.direction[i]), paths.hit[i]);
+}
+
+void WavefrontIntegrator::QueueDirectLight(const Intersection &isx, const Ray &r, const glm::vec3 &beta, int pixel, unsigned int depth, ShadowQueue &shadows)
+{
+    float lightPdf;
+    Geometry* light = scene->light_sampler.Sample(isx.point, Get1D(), lightPdf);
+    if(light == NULL || lightPdf <= 0)
+        return;
+
+    glm::vec3 wo = -r.direction;
+    glm::vec3 wo_local = isx.ToLocalNormalCoordinate(wo);
+    glm::vec3 P = isx.point;
+    glm::vec3 N = isx.normal;
+    float temp;
+
+    //BxDF sampling; the light's emission is only known once the ray is traced
+    if(Number_BRDF > 0)
+    {
+        glm::vec3 wj_local;
+        float pdf_brdf;
+        glm::vec3 F = SampleBSDF(isx, wo_local, wj_local, pdf_brdf);
+        glm::vec3 wj = isx.ToWorldNormalCoordinate(wj_local);
+        float pdf_light = light->RayPDF(isx, Ray(P, wj));
+        if(pdf_brdf > 0 && pdf_light > 0)
+        {
+            float absDot = glm::abs(glm::dot(wj, N));
+            glm::vec3 c = isinf(pdf_brdf) ? F * absDot / pdf_light
+                                          : PowerHeuristic(pdf_brdf, float(Number_BRDF), pdf_light, float(Number_Light)) * F * absDot / pdf_brdf;
+            shadows.Push(Ray(P + 1e-3f * N, wj), beta * c / (float(Number_BRDF) * lightPdf), light, pixel, true, depth);
+        }
+    }
+
+    //Light sampling; everything but visibility is known now
+    for(int i = 0; i < Number_Light; i++)
+    {
+        glm::vec2 uv = Get2D();
+        float u = uv.x;
+        float v = uv.y;
+        Intersection lightSample = light->SampleOnGeometrySurface(u, v, P + 1e-3f * N);
+        glm::vec3 wj = glm::normalize(lightSample.point - P);
+        float pdf_light = light->RayPDF(isx, Ray(P + 1e-3f * wj, wj));
+        float pdf_brdf;
+        glm::vec3 F = isx.object_hit->material->EvaluateScatteredEnergy(isx, wo_local, isx.ToLocalNormalCoordinate(wj), pdf_brdf);
+        if(pdf_light <= 0 || pdf_brdf <= 0)
+            continue;
+        glm::vec3 Ld = light->material->EvaluateScatteredEnergy(lightSample, wo, -wj, temp);
+        float W = PowerHeuristic(pdf_light, float(Number_Light), pdf_brdf, float(Number_BRDF));
+        glm::vec3 c = W * F * Ld * glm::abs(glm::dot(wj, N)) / pdf_light;
+        if(c.x == 0 && c.y == 0 && c.z == 0)
+            continue;
+        shadows.Push(Ray(P + 1e-3f * N, wj), beta * c / (float(Number_Light) * lightPdf), light, pixel, false, depth);
+    }
+}
+
+void WavefrontIntegrator::TraceShadows(ShadowQueue &shadows, std::vector<glm::vec3> &colors, std::vector<AOVSample> *aovs)
+{
+    float temp;
+    for(unsigned int i = 0; i < shadows.origin.size(); i++)
+    {
+        Ray r(shadows.origin[i], shadows.direction[i]);
+        Geometry* hit;
+        GeometryHit found = intersection_engine->root->getIntersectionT(r, hit);
+        if(found.t <= 0 || hit != shadows.light[i])
+            continue;
+        glm::vec3 L = shadows.contribution[i];
+        if(shadows.needs_emission[i])
+        {
+            Intersection isxOnLight = hit->ShadeIntersection(r, found);
+            L *= hit->material->EvaluateScatteredEnergy(isxOnLight, -r.direction, -r.direction, temp);
+        }
+        colors[shadows.pixel[i]] += L;
+        if(aovs != NULL)
+            (*aovs)[shadows.pixel[i]].AddRadiance(L, shadows.depth[i]);
+    }
+}
+
+void WavefrontIntegrator::TraceRays(const std::vector<Ray> &rays, const std::vector<SamplerState> &states, std::vector<glm::vec3> &colors,
+                                    std::vector<AOVSample> *aovs)
+{
+    colors.assign(rays.size(), glm::vec3(0));
+    if(aovs != NULL)
+        aovs->assign(rays.size(), AOVSample());
+    if(max_depth == 0)
+        return;
+
+    unsigned int lanes = glm::min<unsigned int>(queue_size, rays.size());
+    PathQueue paths, next;
+    paths.Resize(lanes);
+    next.Resize(lanes);
+
+    ShadowQueue shadows;
+    std::vector<std::pair<Material*, unsigned int>> byMaterial;
+    byMaterial.reserve(lanes);
+    std::vector<Intersection> hits;
+    MaterialSampleBatch samples;
+
+    //Paths are shaded interleaved, so each one's sampler state is swapped in and out around its draws
+    Sampler* thread_sampler = ThreadSampler();
+    bool resume = !states.empty();
+
+    unsigned int count = 0;
+    unsigned int started = 0;
+    while(true)
+    {
+        //Path regeneration: lanes left free by terminated paths pick up the next camera rays,
+        //so every pass runs over a full queue instead of a shrinking tail of long paths
+        for(; count < lanes && started < rays.size(); count++, started++)
+        {
+            paths.origin[count] = rays[started].origin;
+            paths.direction[count] = rays[started].direction;
+            paths.beta[count] = glm::vec3(1.0f);
+            paths.depth[count] = 0;
+            paths.pixel[count] = started;
+            if(resume)
+                paths.sample[count] = states[started];
+        }
+        if(count == 0)
+            break;
+
+        Intersect(paths, count);
+
+        //Lights end a path: seen directly they show their color, found by a bounce they were already counted by direct lighting
+        byMaterial.clear();
+        for(unsigned int i = 0; i < count; i++)
+        {
+            if(paths.found[i].t <= 0)
+                continue;
+            Material* m = paths.hit[i]->material;
+            if(m->is_light_source)
+            {
+                if(paths.depth[i] == 0)
+                {
+                    Intersection isx = paths.hit[i]->ShadeIntersection(Ray(paths.origin[i], paths.direction[i]), paths.found[i]);
+                    colors[paths.pixel[i]] = isx.texture_color * m->base_color;
+                    if(aovs != NULL)
+                    {
+                        (*aovs)[paths.pixel[i]].SetFirstHit(isx);
+                        (*aovs)[paths.pixel[i]].direct = colors[paths.pixel[i]];
+                    }
+                }
+                continue;
+            }
+            byMaterial.push_back(std::make_pair(m, i));
+        }
+        std::sort(byMaterial.begin(), byMaterial.end());
+
+        shadows.Clear();
+        unsigned int live = 0;
+        for(unsigned int begin = 0, end; begin < byMaterial.size(); begin = end)
+        {
+            Material* m = byMaterial[begin].first;
+            for(end = begin; end < byMaterial.size() && byMaterial[end].first == m; end++);
+
+            //Direct lighting per hit, then every continuation direction of the material in one batched call
+            unsigned int n = end - begin;
+            hits.resize(n);
+            samples.Resize(n);
+            for(unsigned int k = 0; k < n; k++)
+            {
+                unsigned int i = byMaterial[begin + k].second;
+                Ray r(paths.origin[i], paths.direction[i]);
+                hits[k] = paths.hit[i]->ShadeIntersection(r, paths.found[i]);
+                if(aovs != NULL && paths.depth[i] == 0)
+                    (*aovs)[paths.pixel[i]].SetFirstHit(hits[k]);
+                if(resume)
+                    thread_sampler->SetState(paths.sample[i]);
+                QueueDirectLight(hits[k], r, paths.beta[i], paths.pixel[i], paths.depth[i], shadows);
+
+                samples.wo[k] = hits[k].ToLocalNormalCoordinate(-r.direction);
+                samples.texture_color[k] = hits[k].texture_color;
+                samples.u0[k] = Get1D();
+                glm::vec2 u = Get2D();
+                samples.u1[k] = u.x;
+                samples.u2[k] = u.y;
+                if(resume)
+                    paths.sample[i] = thread_sampler->State();
+            }
+            m->SampleAndEvaluateBatch(samples);
+
+            for(unsigned int k = 0; k < n; k++)
+            {
+                unsigned int i = byMaterial[begin + k].second;
+                const Intersection &isx = hits[k];
+                float pdf = samples.pdf[k];
+                if(pdf <= 0 || paths.depth[i] + 1 >= max_depth)
+                    continue;
+                glm::vec3 wj = isx.ToWorldNormalCoordinate(samples.wi[k]);
+                //Delta lobes return F already divided by their pdf
+                glm::vec3 bounce = isinf(pdf) ? samples.F[k] : samples.F[k] * glm::abs(glm::dot(isx.normal, wj)) / pdf;
+
+                glm::vec3 beta = paths.beta[i] * bounce;
+                if(resume)
+                    thread_sampler->SetState(paths.sample[i]);
+                if(RussianRoulette(beta, paths.depth[i]))
+                    continue;
+
+                paths.Copy(i, next, live);
+                if(resume)
+                    next.sample[live] = thread_sampler->State();
+                next.origin[live] = isx.point + glm::sign(glm::dot(wj, isx.normal)) * 1e-3f * isx.normal;
+                next.direction[live] = wj;
+                next.beta[live] = beta;
+                next.depth[live] = paths.depth[i] + 1;
+                live++;
+            }
+        }
+
+        TraceShadows(shadows, colors, aovs);
+
+        std::swap(paths, next);
+        count = live;
+    }
+}
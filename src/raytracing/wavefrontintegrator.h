@@ -0,0 +1,63 @@
+#pragma once
+#include <la.h>
+#include <raytracing/integrator.h>
+
+//Runs the same estimator as Integrator (one-light direct lighting at every vertex, BxDF-sampled continuation,
+//Russian roulette) breadth-first over a whole batch of camera rays instead of one path at a time.
+//Each bounce is a sequence of passes over structure-of-arrays queues of at most queue_size paths:
+//  1. closest-hit t for every live ray, with no shading
+//  2. hits grouped by material, so each material's BxDFs and textures stay hot while its hits are shaded
+//  3. shading per material: shadow rays for direct lighting are queued, continuation directions sampled with one
+//     batched Material::SampleAndEvaluateBatch call, continuation rays written back compacted
+//  4. every queued shadow ray traced in one pass
+//Lanes whose paths ended are refilled with the batch's next camera rays before the following bounce.
+class WavefrontIntegrator : public Integrator
+{
+public:
+    WavefrontIntegrator();
+
+    virtual glm::vec3 TraceRay(Ray r, unsigned int depth);
+    virtual void TraceRays(const std::vector<Ray> &rays, const std::vector<SamplerState> &states, std::vector<glm::vec3> &colors,
+                           std::vector<AOVSample> *aovs = NULL);
+
+    //Number of paths in flight. A batch with more rays than this starts new camera rays in the lanes that paths free up.
+    void SetQueueSize(unsigned int size);
+
+private:
+    //Live paths, one entry per index
+    struct PathQueue
+    {
+        std::vector<glm::vec3> origin, direction;
+        std::vector<glm::vec3> beta;//Product of F * |cos| / pdf so far, over the roulette survival probabilities
+        std::vector<unsigned int> depth;//Bounces so far; paths in one queue can be at different depths once lanes are regenerated
+        std::vector<int> pixel;//Index into the output colors
+        std::vector<SamplerState> sample;//Where each path's sample left off, restored while that path is shaded
+        std::vector<GeometryHit> found;//t of the closest hit, and the part of hit it landed on
+        std::vector<Geometry*> hit;
+
+        void Resize(unsigned int n);
+        void Copy(unsigned int from, PathQueue &to, unsigned int slot) const;
+    };
+
+    //Shadow rays toward a chosen light. If the first thing they hit is that light, contribution is added to pixel.
+    //Rays from BxDF sampling also need the light's emission at the point they hit, times contribution.
+    struct ShadowQueue
+    {
+        std::vector<glm::vec3> origin, direction;
+        std::vector<glm::vec3> contribution;
+        std::vector<Geometry*> light;
+        std::vector<int> pixel;
+        std::vector<bool> needs_emission;
+        std::vector<unsigned int> depth;//Depth of the path vertex the ray leaves from, to split direct from indirect AOVs
+
+        void Clear();
+        void Push(const Ray &r, const glm::vec3 &c, Geometry* l, int p, bool emission, unsigned int d);
+    };
+
+    void Intersect(PathQueue &paths, unsigned int count);
+    //Queues direct lighting from one light at isx for the path writing to pixel, mirroring MIS_SampleLight and MIS_SampleBRDF_Ld
+    void QueueDirectLight(const Intersection &isx, const Ray &r, const glm::vec3 &beta, int pixel, unsigned int depth, ShadowQueue &shadows);
+    void TraceShadows(ShadowQueue &shadows, std::vector<glm::vec3> &colors, std::vector<AOVSample> *aovs);
+
+    unsigned int queue_size;
+};
@@ -1,43 +1,109 @@
 #include <renderthread.h>
-#include <raytracing/samplers/stratifiedpixelsampler.h>
-#include <QImage>
 
-QMutex RenderThread::mutex;
-
-RenderThread::RenderThread(unsigned int xstart, unsigned int xend, unsigned int ystart, unsigned int yend, unsigned int samplesSqrt, unsigned int depth, Film *f, Camera *c, Integrator *i,QImage* qI)
-    : x_start(xstart), x_end(xend), y_start(ystart), y_end(yend), samples_sqrt(samplesSqrt), max_depth(depth), film(f), camera(c), integrator(i), renderImage(qI)
+RenderThread::RenderThread(unsigned int xstart, unsigned int xend, unsigned int ystart, unsigned int yend, unsigned int sampleEnd, unsigned int depth, Film *f, Camera *c, Integrator *i, TileQueue* q, Filter* flt)
+    : tiles(q), x_start(xstart), x_end(xend), y_start(ystart), y_end(yend), sample_end(sampleEnd), max_depth(depth), film(f), camera(c), integrator(i), filter(flt), cancelled(false)
 {}
 
+void RenderThread::Cancel()
+{
+    cancelled = true;
+}
+
 void RenderThread::run()
 {
+    //Later passes over the same tile get their own light paths
     unsigned int seed = (((x_start << 16 | x_end) ^ x_start) * ((y_start << 16 | y_end) ^ y_start));
-    StratifiedPixelSampler pixel_sampler(samples_sqrt, seed);
+    seed ^= film->SampleCount(x_start, y_start) * 0x9e3779b9u;
+    integrator->SeedThreadGenerator(seed);
 
-    integrator->generator = std::mt19937(seed);
+    //Every value a camera sample uses, from its film position on, comes from this thread's sampler
+    Sampler* sampler = integrator->ThreadSampler();
 
-    for(unsigned int Y = y_start; Y < y_end; Y++)
+    //Rows are handed to the integrator in batches of at least this many rays,
+    //so a breadth-first integrator has a full queue to work on
+    const unsigned int min_batch_rays = 4096;
+    std::vector<Ray> rays;
+    std::vector<SamplerState> states;
+    std::vector<glm::vec3> colors;
+    std::vector<glm::vec2> screens;
+    std::vector<AOVSample> aovs;
+    std::vector<AOVSample> *aovs_out = film->AOVsEnabled() ? &aovs : NULL;
+
+    //With a filter, samples near the tile's edge reach pixels up to its radius outside the tile
+    int border = filter != NULL ? int(glm::ceil(filter->Radius())) : 0;
+    FilmTile tile;
+    tile.Reset(int(x_start) - border, int(y_start) - border, int(x_end) + border, int(y_end) + border);
+
+    for(unsigned int Y0 = y_start; Y0 < y_end && !cancelled;)
     {
-        for(unsigned int X = x_start; X < x_end; X++)
+        rays.clear();
+        states.clear();
+        screens.clear();
+        unsigned int Y1 = Y0;
+        while(Y1 < y_end && (Y1 == Y0 || rays.size() < min_batch_rays))
         {
-            glm::vec3 pixel_color;
-            QList<glm::vec2> samples = pixel_sampler.GetSamples(X, Y);
-            for(int i = 0; i < samples.size(); i++)
+            for(unsigned int X = x_start; X < x_end; X++)
             {
-                Ray ray = camera->Raycast(samples[i]);
-                pixel_color += integrator->TraceRay(ray, 0);
+                for(unsigned int i = film->SampleCount(X, Y1); i < sample_end; i++)
+                {
+                    sampler->StartPixelSample(glm::ivec2(X, Y1), i);
+                    glm::vec2 screen;
+                    rays.push_back(camera->Raycast(glm::ivec2(X, Y1), *sampler, screen));
+                    states.push_back(sampler->State());
+                    screens.push_back(screen);
+                }
             }
-            pixel_color /= samples.size();
-            film->pixels[X][Y] = pixel_color;
+            Y1++;
+        }
+
+        integrator->TraceRays(rays, states, colors, aovs_out);
 
-            mutex.lock();
-            renderImage->setPixel(QPoint(X,Y),
-                                  qRgba((int)(glm::clamp(pixel_color.x,0.0f,1.0f) * 255),
-                                        (int)(glm::clamp(pixel_color.y,0.0f,1.0f) * 255),
-                                        (int)(glm::clamp(pixel_color.z,0.0f,1.0f) * 255),
-                                        255));
-            mutex.unlock();
+        if(filter != NULL)
+        {
+            for(unsigned int i = 0; i < colors.size(); i++)
+                tile.AddSample(screens[i], colors[i], *filter);
+        }
+
+        unsigned int ray_index = 0;
+        for(unsigned int Y = Y0; Y < Y1; Y++)
+        {
+            for(unsigned int X = x_start; X < x_end; X++)
+            {
+                unsigned int &count = film->SampleCount(X, Y);
+                unsigned int n = sample_end > count ? sample_end - count : 0;
+
+                //AOVs are averaged within the pixel whether or not the color is filtered, then folded into earlier passes'
+                if(aovs_out != NULL && n > 0)
+                {
+                    AOVSample pass = AOVSample::Average(&aovs[ray_index], n);
+                    AOVSample &pixel_aov = film->AOV(X, Y);
+                    if(count > 0 && pixel_aov.has_first_hit)
+                        pixel_aov.Merge(pass, count, n);
+                    else
+                        pixel_aov = pass;
+                }
 
+                if(filter == NULL)
+                {
+                    for(unsigned int i = 0; i < n; i++)
+                        tile.AddPixelSample(X, Y, colors[ray_index + i]);
+                }
+                ray_index += n;
+                count += n;
 
+                //A preview only: rows below this batch and other threads' borders still add to it,
+                //and the film is resolved from the merged tiles once the pass is done
+                glm::vec4 sum = film->Accumulated(X, Y) + tile.Sum(X, Y);
+                film->Pixel(X, Y) = sum.w != 0 ? glm::max(glm::vec3(sum) / sum.w, glm::vec3(0)) : glm::vec3(0);
+            }
         }
+        if(tiles != NULL)
+            tiles->PushDirty(QRect(x_start, Y0, x_end - x_start, Y1 - Y0));
+        Y0 = Y1;
     }
+
+    if(!cancelled)
+        film->MergeTile(tile);
+    if(tiles != NULL)
+        tiles->PushFinished();
 }
@@ -1,10 +1,12 @@
 #pragma once
 
 #include <QThread>
+#include <atomic>
 #include <raytracing/film.h>
 #include <scene/scene.h>
 #include <raytracing/integrator.h>
-#include <QMutex>
+#include <raytracing/filters/filter.h>
+#include <tilequeue.h>
 #include <mygl.h>
 
 class MyGL;
@@ -16,22 +18,26 @@ class RenderThread : public QThread
 public:
     RenderThread(unsigned int xstart, unsigned int xend,
             unsigned int ystart, unsigned int yend,
-            unsigned int samplesSqrt, unsigned int depth,
-            Film* f, Camera* c, Integrator* i, QImage* gfb);
+            unsigned int sampleEnd, unsigned int depth,
+            Film* f, Camera* c, Integrator* i, TileQueue* q, Filter* flt = NULL);
+
+    //Asks the thread to stop after the rows it's tracing. Its tile is then never merged, and the rows it did
+    //finish are left in the film, so a cancelled render's film is only good for clearing. Safe from any thread.
+    void Cancel();
 
 protected:
     //This overrides the functionality of QThread::run
     virtual void run();
     glm::vec3 TraceRay(Ray r, unsigned int depth);// IntersectionEngine* intersection_engine, Scene* scene);
 
-    QImage* renderImage;
+    TileQueue* tiles;//Told which rows of the film were redrawn and when the thread is done; NULL when nobody is watching
 
     unsigned int x_start, x_end, y_start, y_end;
-    unsigned int samples_sqrt;//The square root of the number of rays to cast per pixel
+    unsigned int sample_end;//Each pixel is traced from the sample index after the film's last one for it up to this one
     unsigned int max_depth;
     Film* film;
     Camera* camera;
     Integrator* integrator;
-
-    static QMutex mutex;
+    Filter* filter;//NULL averages the samples inside each pixel; otherwise samples are splatted across pixels
+    std::atomic<bool> cancelled;
 };
@@ -152,6 +152,35 @@ Ray Camera::Raycast(float x, float y)
 }
 
 Ray Camera::RaycastNDC(float ndc_x, float ndc_y)
+{
+    glm::vec2 lens_sample(0.5f);
+    if(lensRadius > 0)
+    {
+        std::mt19937 generator(std::chrono::system_clock::now().time_since_epoch().count());
+        std::uniform_real_distribution<float> uniform_distribution(0.0f,1.0f);
+        lens_sample.x = uniform_distribution(generator);
+        lens_sample.y = uniform_distribution(generator);
+    }
+    return RaycastNDC(ndc_x, ndc_y, lens_sample);
+}
+
+Ray Camera::Raycast(const glm::ivec2 &pixel, Sampler &sampler)
+{
+    glm::vec2 screen;
+    return Raycast(pixel, sampler, screen);
+}
+
+Ray Camera::Raycast(const glm::ivec2 &pixel, Sampler &sampler, glm::vec2 &screen)
+{
+    glm::vec2 film = sampler.Get2D();
+    glm::vec2 lens = sampler.Get2D();
+    screen = glm::vec2(pixel) + film;
+    float ndc_x = (2*screen.x/width - 1);
+    float ndc_y = (1 - 2*screen.y/height);
+    return RaycastNDC(ndc_x, ndc_y, lens);
+}
+
+Ray Camera::RaycastNDC(float ndc_x, float ndc_y, const glm::vec2 &lens_sample)
 {
     glm::vec3 P = ref + ndc_x*H + ndc_y*V;
     Ray result(eye, P - eye);
@@ -162,11 +191,8 @@ Ray Camera::RaycastNDC(float ndc_x, float ndc_y)
         glm::vec3 eye2ref = P - eye;
         glm::vec3 eye2focalRef = focalLength / glm::distance(ref , eye) * eye2ref;
 
-        std::mt19937 generator(std::chrono::system_clock::now().time_since_epoch().count());
-        std::uniform_real_distribution<float> uniform_distribution(-1.0f,1.0f);
-
-        float u=uniform_distribution(generator);
-        float v=uniform_distribution(generator);
+        float u = 2.0f * lens_sample.x - 1.0f;
+        float v = 2.0f * lens_sample.y - 1.0f;
 
         glm::vec3 newEye(eye + up*lensRadius*u+right*lensRadius*v);
 
@@ -175,6 +201,31 @@ Ray Camera::RaycastNDC(float ndc_x, float ndc_y)
     return result;
 }
 
+bool Camera::WorldToScreen(const glm::vec3 &p, glm::vec2 &screen) const
+{
+    glm::vec3 d = p - eye;
+    float z = glm::dot(d, look);
+    if(z <= 0)
+        return false;
+
+    //Where the ray toward p crosses the plane through ref, relative to ref
+    float len = glm::length(ref - eye);
+    glm::vec3 P = d * (len / z) - (ref - eye);
+    float ndc_x = glm::dot(P, H) / glm::length2(H);
+    float ndc_y = glm::dot(P, V) / glm::length2(V);
+    if(ndc_x < -1 || ndc_x > 1 || ndc_y < -1 || ndc_y > 1)
+        return false;
+
+    screen = glm::vec2((ndc_x + 1) * 0.5f * width, (1 - ndc_y) * 0.5f * height);
+    return true;
+}
+
+float Camera::ImagePlaneArea() const
+{
+    float len2 = glm::length2(ref - eye);
+    return 4.0f * glm::length(H) * glm::length(V) / len2;
+}
+
 void Camera::create()
 {
     std::vector<glm::vec3> pos;
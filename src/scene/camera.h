@@ -3,6 +3,7 @@
 #include <la.h>
 
 #include <raytracing/ray.h>
+#include <raytracing/samplers/sampler.h>
 #include <openGL/drawable.h>
 
 //A perspective projection camera
@@ -43,6 +44,17 @@ public:
     Ray Raycast(const glm::vec2 &pt);         //Creates a ray in 3D space given a 2D point on the screen, in screen coordinates.
     Ray Raycast(float x, float y);            //Same as above, but takes two floats rather than a vec2.
     Ray RaycastNDC(float ndc_x, float ndc_y); //Creates a ray in 3D space given a 2D point in normalized device coordinates.
+    //Creates the ray for sampler's current sample of pixel. The position within the pixel and the point on the lens
+    //are the sampler's next two 2D samples; both are drawn even without depth of field so later dimensions line up.
+    Ray Raycast(const glm::ivec2 &pixel, Sampler &sampler);
+    //Same as above, also giving the sample's screen coordinates for reconstruction filtering
+    Ray Raycast(const glm::ivec2 &pixel, Sampler &sampler, glm::vec2 &screen);
+
+    //The inverse of Raycast for a pinhole camera: the screen coordinates p projects to. False if p is behind the eye or off screen.
+    bool WorldToScreen(const glm::vec3 &p, glm::vec2 &screen) const;
+    //Area of the image plane at distance 1 from the eye. A pinhole's importance toward a direction at angle theta to LOOK
+    //is 1 / (area * cos^4 theta), normalized so that it integrates to 1 over the image.
+    float ImagePlaneArea() const;
 
     void RotateAboutUp(float deg);
     void RotateAboutRight(float deg);
@@ -60,4 +72,8 @@ public:
     //DOF VARIABLES
     float lensRadius;
     float focalLength;
+
+private:
+    //lens_sample in [0,1)^2 picks the point on the (square) lens
+    Ray RaycastNDC(float ndc_x, float ndc_y, const glm::vec2 &lens_sample);
 };
@@ -64,17 +64,43 @@ Intersection Cube::SampleOnGeometrySurface(const float &u, const float &v, const
 
 Intersection Cube::RandomSampleOnSurface(const float &u, const float &v)
 {
-    return Intersection();
+    //Pick a face by its world-space area, then a uniform point on it
+    glm::vec3 scale = transform.getScale();
+    float faceArea[3] = {scale.y * scale.z, scale.x * scale.z, scale.x * scale.y};
+    float total = 2.0f * (faceArea[0] + faceArea[1] + faceArea[2]);
+
+    float x = u * total;
+    int face = 0;
+    while(face < 5 && x >= faceArea[face / 2])
+    {
+        x -= faceArea[face / 2];
+        face++;
+    }
+    float u_face = glm::clamp(x / faceArea[face / 2], 0.0f, 1.0f);
+
+    int axis = face / 2;
+    glm::vec3 localSamplePoint;
+    localSamplePoint[axis] = face % 2 == 0 ? 0.5f : -0.5f;
+    localSamplePoint[(axis + 1) % 3] = u_face - 0.5f;
+    localSamplePoint[(axis + 2) % 3] = v - 0.5f;
+
+    Intersection isx;
+    isx.t = 1.0f;
+    isx.point = transform.TransformPoint(localSamplePoint);
+    isx.texture_color = Material::GetImageColorInterp(GetUVCoordinates(localSamplePoint), material->texture);
+    isx.object_hit = this;
+    SetNormalTangentBitangent(localSamplePoint,isx);
+    return isx;
 }
 
 void Cube::SetNormalTangentBitangent(const glm::vec3 &point_local, Intersection &isx)
 {
-    glm::vec3 P = point_local;
-    glm::vec3 up(0,1,0);
-
-    if(fequal(P.y, 0.5f) || fequal(P.y, -0.5f))
-        up=glm::vec3(1,0,0);
+    isx.SetNormal(glm::normalize(transform.TransformNormal(ComputeNormal(point_local))));
+}
 
+//Object-space normal of the face P lies on: the axis P is furthest along
+glm::vec3 Cube::ComputeNormal(const glm::vec3 &P)
+{
     int idx = 0;
     float val = -1;
     for(int i = 0; i < 3; i++){
@@ -86,22 +112,21 @@ void Cube::SetNormalTangentBitangent(const glm::vec3 &point_local, Intersection
 
     glm::vec3 normal_local(0,0,0);
     normal_local[idx] = glm::sign(P[idx]);
-    glm::vec3 tangent_local = glm::normalize(glm::cross(up,normal_local));
-    glm::vec3 bitangent_local = glm::normalize(glm::cross(normal_local,tangent_local));
-
-    isx.normal = glm::normalize(glm::vec3(transform.invTransT() * glm::vec4(normal_local,0.0f)));
-    isx.tangent = glm::normalize(glm::vec3(transform.T() * glm::vec4(tangent_local,0.0f)));
-    isx.bitangent = glm::normalize(glm::vec3(transform.T() * glm::vec4(bitangent_local,0.0f)));
+    return normal_local;
 }
 
-glm::vec3 Cube::ComputeNormal(const glm::vec3 &P)
-{return glm::vec3(0);}
-
 Intersection Cube::GetIntersection(Ray r)
 {
-    //Transform the ray
-    Ray r_loc = r.GetTransformedCopy(transform.invT());
-    Intersection result;
+    GeometryHit hit = GetIntersectionT(r);
+    if(hit.t < 0)
+        return Intersection();
+    return ShadeIntersection(r, hit);
+}
+
+GeometryHit Cube::GetIntersectionT(const Ray &r)
+{
+    //Transform the ray, t against r_loc is also t against r
+    Ray r_loc = ToLocalRay(r);
 
     float t_n = -1000000;
     float t_f = 1000000;
@@ -109,7 +134,7 @@ Intersection Cube::GetIntersection(Ray r)
         //Ray parallel to slab check
         if(r_loc.direction[i] == 0){
             if(r_loc.origin[i] < -0.5f || r_loc.origin[i] > 0.5f){
-                return result;
+                return -1;
             }
         }
         //If not parallel, do slab intersect check
@@ -139,23 +164,23 @@ Intersection Cube::GetIntersection(Ray r)
             t_final = t_f;
         }
     }
-    if(t_final >= 0)
-    {
-        //Lastly, transform the point found in object space by T
-        glm::vec4 P = glm::vec4(r_loc.origin + t_final*r_loc.direction, 1);
-        result.point = glm::vec3(transform.T() * P);
-        result.object_hit = this;
-        result.t = glm::distance(result.point, r.origin);
-        result.texture_color = Material::GetImageColorInterp(GetUVCoordinates(glm::vec3(P)), material->texture);
+    return t_final;
+}
 
-        // Store the tangent and bitangent
-        SetNormalTangentBitangent(glm::vec3(P),result);
+Intersection Cube::ShadeIntersection(const Ray &r, const GeometryHit &hit)
+{
+    Ray r_loc = ToLocalRay(r);
+    glm::vec3 P = r_loc.origin + hit.t*r_loc.direction;
 
-        return result;
-    }
-    else{
-        return result;
-    }
+    Intersection result;
+    result.point = r.origin + hit.t*r.direction;
+    result.object_hit = this;
+    result.t = hit.t;
+    result.texture_color = Material::GetImageColorInterp(GetUVCoordinates(P), material->texture);
+
+    // Store the tangent and bitangent
+    SetNormalTangentBitangent(P,result);
+    return result;
 }
 
 glm::vec2 Cube::GetUVCoordinates(const glm::vec3 &point)
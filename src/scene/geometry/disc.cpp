@@ -39,27 +39,40 @@ Intersection Disc::SampleOnGeometrySurface(const float &u, const float &v, const
 
 Intersection Disc::GetIntersection(Ray r)
 {
-    //Transform the ray
-    Ray r_loc = r.GetTransformedCopy(transform.invT());
-    Intersection result;
+    GeometryHit hit = GetIntersectionT(r);
+    if(hit.t < 0)
+        return Intersection();
+    return ShadeIntersection(r, hit);
+}
+
+GeometryHit Disc::GetIntersectionT(const Ray &r)
+{
+    //Transform the ray, t against r_loc is also t against r
+    Ray r_loc = ToLocalRay(r);
 
-    //Ray-plane intersection
-    float t = glm::dot(glm::vec3(0,0,1), (glm::vec3(0.5f, 0.5f, 0) - r_loc.origin)) / glm::dot(glm::vec3(0,0,1), r_loc.direction);
-    glm::vec4 P = glm::vec4(t * r_loc.direction + r_loc.origin, 1);
+    //Ray-plane intersection against z = 0. A ray parallel to the plane gives inf or nan, which fails the bounds test
+    float t = -r_loc.origin.z / r_loc.direction.z;
+    glm::vec3 P = r_loc.origin + t*r_loc.direction;
     //Check that P is within the bounds of the disc (not bothering to take the sqrt of the dist b/c we know the radius)
-    float dist2 = (P.x * P.x + P.y * P.y);
+    float dist2 = P.x * P.x + P.y * P.y;
     if(t > 0 && dist2 <= 0.25f)
-    {
-        result.point = glm::vec3(transform.T() * P);
-        result.object_hit = this;
-        result.t = glm::distance(result.point, r.origin);
-        result.texture_color = Material::GetImageColorInterp(GetUVCoordinates(glm::vec3(P)), material->texture);
+        return t;
+    return -1;
+}
 
-        //Store the tangent and bitangent
-        SetNormalTangentBitangent(glm::vec3(P),result);
+Intersection Disc::ShadeIntersection(const Ray &r, const GeometryHit &hit)
+{
+    Ray r_loc = ToLocalRay(r);
+    glm::vec3 P = r_loc.origin + hit.t*r_loc.direction;
 
-        return result;
-    }
+    Intersection result;
+    result.point = r.origin + hit.t*r.direction;
+    result.object_hit = this;
+    result.t = hit.t;
+    result.texture_color = Material::GetImageColorInterp(GetUVCoordinates(P), material->texture);
+
+    //Store the tangent and bitangent
+    SetNormalTangentBitangent(P, result);
     return result;
 }
 
@@ -71,16 +84,10 @@ Intersection Disc::RandomSampleOnSurface(const float &u, const float &v)
 
 void Disc::SetNormalTangentBitangent(const glm::vec3& point_local, Intersection& isx)
 {
-    glm::vec3 up(0,1,0);
-
     glm::vec3 normal_local = glm::vec3(0,0,1);
-    glm::vec3 tangent_local = glm::normalize(glm::cross(up,normal_local));
-    glm::vec3 bitangent_local = glm::normalize(glm::cross(normal_local,tangent_local));
 
-    // transform to world coordinates
-    isx.normal = glm::normalize(glm::vec3(transform.invTransT() * glm::vec4(normal_local,0.0f)));
-    isx.tangent = glm::normalize(glm::vec3(transform.T() * glm::vec4(tangent_local,0.0f)));
-    isx.bitangent = glm::normalize(glm::vec3(transform.T() * glm::vec4(bitangent_local,0.0f)));
+    // transform to world coordinates, the tangent frame is built from the world normal
+    isx.SetNormal(glm::normalize(transform.TransformNormal(normal_local)));
 }
 
 glm::vec2 Disc::GetUVCoordinates(const glm::vec3 &point)
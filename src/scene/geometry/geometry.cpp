@@ -23,7 +23,6 @@ float Geometry::RayPDF(const Intersection &isx, const Ray &ray)
 //    return pdf;
 }
 
-
 glm::vec3 Geometry::toLocalDirection(const glm::vec3 &a)
 {
     glm::vec4 direct(a, 0.0f);
@@ -10,13 +10,14 @@
 
 class Material;
 class Intersection;
+struct GeometryHit;
 
 //Geometry is an abstract class since it contains a pure virtual function (i.e. a virtual function that is set to 0)
 class Geometry : public Drawable
 {
 public:
 //Constructors/destructors
-    Geometry() : name("GEOMETRY"), transform(), area(1.0f)
+    Geometry() : name("GEOMETRY"), id(-1), transform(), area(1.0f)
     {
         material = NULL;
         bBox = NULL;
@@ -24,6 +25,13 @@ public:
 //Functions
     virtual ~Geometry(){}
     virtual Intersection GetIntersection(Ray r) = 0;
+
+    //Intersect-only kernel: returns the world-space t of the nearest hit in front of r (-1 on a miss) and, for a
+    //shape made of others, which one was hit. No hit data is computed, so traversal can test many candidates
+    //and shade only the closest one.
+    virtual GeometryHit GetIntersectionT(const Ray &r) = 0;
+    //Fills in the point, normal frame and texture color of a hit that GetIntersectionT found along r.
+    virtual Intersection ShadeIntersection(const Ray &r, const GeometryHit &hit) = 0;
     virtual void SetMaterial(Material* m){material = m;}
     virtual glm::vec2 GetUVCoordinates(const glm::vec3 &point) = 0;
     virtual glm::vec3 ComputeNormal(const glm::vec3 &P) = 0;
@@ -44,6 +52,13 @@ public:
 
     virtual void SetNormalTangentBitangent(const glm::vec3& point_local, Intersection& isx) = 0;
 
+    //Returns r in object space for the intersection kernels. The direction is left unnormalized,
+    //so the t found against the returned ray is already the world-space t of r.
+    inline Ray ToLocalRay(const Ray &r) const
+    {
+        return transform.IsIdentity() ? r : r.GetAffineTransformedCopy(transform.affineInvT());
+    }
+
     // useless ones
     glm::vec3 toLocalDirection(const glm::vec3& a);
     glm::vec3 toLocalPoint(const glm::vec3& a);
@@ -59,6 +74,7 @@ public:
 
 //Member variables
     QString name;//Mainly used for debugging purposes
+    int id;//Index in Scene::objects, written to the object ID AOV
     Transform transform;
     Material* material;
     float area;
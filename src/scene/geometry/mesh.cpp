@@ -2,6 +2,7 @@
 #include <la.h>
 #include <tinyobj/tiny_obj_loader.h>
 #include <iostream>
+#include <algorithm>
 
 void Triangle::ComputeArea()
 {
@@ -13,18 +14,17 @@ void Triangle::ComputeArea()
 }
 
 Intersection Triangle::SampleOnGeometrySurface(const float &u, const float &v, const glm::vec3 &point)
-{   
-
-    glm::vec3 p_prime = points[1] * (1-u) + u * points[2];
-    glm::vec3 samplePoint = points[0] * (1-v) + v * p_prime;
+{
+    //The square root keeps the samples uniform in area rather than bunched up at points[0]
+    float su = glm::sqrt(u);
+    glm::vec3 p_prime = points[1] * (1-v) + v * points[2];
+    glm::vec3 samplePoint = points[0] * (1-su) + su * p_prime;
 
     Intersection sample;
     sample.point = samplePoint;
-    sample.normal = GetNormal(sample.point);
+    sample.SetNormal(GetNormal(sample.point));
     sample.texture_color = Material::GetImageColorInterp(GetUVCoordinates(samplePoint), material->texture);
     sample.t = 1.0f;//?
-    sample.tangent = glm::normalize(glm::cross(glm::vec3(0,1,0), sample.normal));
-    sample.bitangent = glm::normalize(glm::cross(sample.normal, sample.tangent));
     sample.object_hit = this;
 
     return sample;
@@ -37,53 +37,62 @@ Intersection Triangle::RandomSampleOnSurface(const float &u, const float &v)
 
 Intersection Mesh::RandomSampleOnSurface(const float &u, const float &v)
 {
-    return Intersection();
+    float u_face = u;
+    Triangle* face = SampleFace(u_face);
+    if(face == NULL)
+        return Intersection();
+
+    Intersection sample = face->SampleOnGeometrySurface(u_face,v,glm::vec3(0));
+    sample.point = transform.TransformPoint(sample.point);
+    sample.SetNormal(glm::normalize(transform.TransformNormal(sample.normal)));
+    sample.object_hit = this;
+    return sample;
+}
+
+Triangle* Mesh::SampleFace(float &u) const
+{
+    if(area_cdf.empty())
+        return NULL;
+
+    int i = std::upper_bound(area_cdf.begin(), area_cdf.end(), u) - area_cdf.begin();
+    i = glm::min(i, int(area_cdf.size()) - 1);
+    float low = i > 0 ? area_cdf[i-1] : 0.0f;
+    float width = area_cdf[i] - low;
+    u = width > 0 ? glm::min((u - low) / width, 0.99999994f) : 0.0f;
+    return faces[i];
 }
 
 void Mesh::ComputeArea()
 {
-    //Extra credit to implement this
+    //Triangles are stored in object space, so measure them after the mesh's transform.
+    //Their object-space area is kept on each face for Triangle's own use.
+    area = 0;
+    area_cdf.resize(faces.size());
     for(int i=0;i<faces.size();i++)
     {
         faces[i]->ComputeArea();
-        area += faces[i]->area;
         faces[i]->material = this->material;
+
+        glm::vec3 p0 = transform.TransformPoint(faces[i]->points[0]);
+        glm::vec3 p1 = transform.TransformPoint(faces[i]->points[1]);
+        glm::vec3 p2 = transform.TransformPoint(faces[i]->points[2]);
+        area += glm::length(glm::cross(p1 - p0, p2 - p0)) / 2.0f;
+        area_cdf[i] = area;
+    }
+    if(area > 0)
+    {
+        for(float &c : area_cdf)
+            c /= area;
     }
 }
 
+//Area sampling, so the pdf with respect to area is 1/area and Geometry::RayPDF converts it to solid angle
 Intersection Mesh::SampleOnGeometrySurface(const float &u, const float &v, const glm::vec3 &point)
 {
-
-    glm::vec3 localPoint = glm::vec3(transform.invT() * glm::vec4(point, 1.0f));
-    Ray ray(localPoint, -localPoint);
-    Triangle* cloest = NULL;
-    float min_t = INFINITY;
-
-    for(int i=0;i<faces.size();i++)
-    {
-        Intersection inter = faces[i]->GetIntersection(ray);
-        if(inter.t > 0 && inter.object_hit != NULL)
-        {
-            if(inter.t < min_t)
-            {
-                min_t = inter.t;
-                cloest = faces[i];
-            }
-        }
-    }
-    if(cloest == NULL)
-        return Intersection();
-
-    Intersection sample = cloest->SampleOnGeometrySurface(u,v,localPoint);
-    glm::vec3 normal_local = sample.normal;
-    glm::vec3 tangent_local = sample.tangent;
-    glm::vec3 bitangent_local = sample.bitangent;
-
-    sample.point = glm::vec3(transform.T() * glm::vec4(sample.point, 1.0f));
+    Intersection sample = RandomSampleOnSurface(u,v);
+    if(sample.object_hit == NULL)
+        return sample;
     sample.t = glm::length(sample.point - point);
-    sample.normal = glm::normalize(glm::vec3(transform.invTransT() * glm::vec4(normal_local,0.0f)));
-    sample.tangent = glm::normalize(glm::vec3(transform.T() * glm::vec4(tangent_local,0.0f)));
-    sample.bitangent = glm::normalize(glm::vec3(transform.T() * glm::vec4(bitangent_local,0.0f)));
     return sample;
 }
 
@@ -145,9 +154,18 @@ glm::vec3 Mesh::ComputeNormal(const glm::vec3 &P)
 //HAVE THEM IMPLEMENT THIS
 //The ray in this function is not transformed because it was *already* transformed in Mesh::GetIntersection
 Intersection Triangle::GetIntersection(Ray r){
+    GeometryHit hit = GetIntersectionT(r);
+    if(hit.t < 0)
+        return Intersection();
+    return ShadeIntersection(r, hit);
+}
+
+GeometryHit Triangle::GetIntersectionT(const Ray &r)
+{
     //1. Ray-plane intersection
-    Intersection result;
     float t =  glm::dot(plane_normal, (points[0] - r.origin)) / glm::dot(plane_normal, r.direction);
+    if(!(t > 0))
+        return -1;
 
     glm::vec3 P = r.origin + t * r.direction;
     //2. Barycentric test
@@ -157,16 +175,23 @@ Intersection Triangle::GetIntersection(Ray r){
     float s3 = 0.5f * glm::length(glm::cross(P - points[0], P - points[1]))/S;
     float sum = s1 + s2 + s3;
 
-    if(s1 >= 0 && s1 <= 1 && s2 >= 0 && s2 <= 1 && s3 >= 0 && s3 <= 1 && fequal(sum, 1.0f)){
-        result.t = t;
-        result.texture_color = Material::GetImageColorInterp(GetUVCoordinates(glm::vec3(P)), material->texture);
-        result.object_hit = this;
+    if(s1 >= 0 && s1 <= 1 && s2 >= 0 && s2 <= 1 && s3 >= 0 && s3 <= 1 && fequal(sum, 1.0f))
+        return t;
+    return -1;
+}
 
-        // Store the tangent and bitangent
-        //result.tangent = glm::normalize(glm::cross(glm::vec3(0,1,0), result.normal));
-        //result.bitangent = glm::normalize(glm::cross(result.normal, result.tangent));
-        SetNormalTangentBitangent(P,result);
-    }
+Intersection Triangle::ShadeIntersection(const Ray &r, const GeometryHit &hit)
+{
+    glm::vec3 P = r.origin + hit.t * r.direction;
+
+    Intersection result;
+    result.point = P;
+    result.t = hit.t;
+    result.texture_color = Material::GetImageColorInterp(GetUVCoordinates(P), material->texture);
+    result.object_hit = this;
+
+    // Store the tangent and bitangent
+    SetNormalTangentBitangent(P,result);
     return result;
 }
 
@@ -197,20 +222,31 @@ Intersection Mesh::GetIntersection(Ray r){
     return closest;
     */
 
-    // using bvh tree
-    Ray r_loc = r.GetTransformedCopy(transform.invT());
-    Intersection isx = bvhTree->getIntersection(r_loc);
-    if(isx.t > 0)
-    {
-        glm::vec4 p_local = glm::vec4(isx.t * r_loc.direction + r_loc.origin,1.0f);
-        SetNormalTangentBitangent(glm::vec3(p_local),isx);
-        isx.point = glm::vec3(transform.T() * p_local);
-        isx.object_hit = this;
-        isx.t = glm::distance(isx.point,r.origin);
-        return isx;
-    }
-    else
+    GeometryHit hit = GetIntersectionT(r);
+    if(hit.t < 0)
         return Intersection();
+    return ShadeIntersection(r, hit);
+}
+
+GeometryHit Mesh::GetIntersectionT(const Ray &r)
+{
+    // using bvh tree, the triangles are tested directly against r_loc (they have no transform of their own)
+    // and since r_loc keeps an unnormalized direction the t they return is already the world-space t.
+    // Only the triangles' t kernels run here; the one that was hit is kept for ShadeIntersection
+    Geometry* triangle = NULL;
+    GeometryHit hit = bvhTree->getIntersectionT(ToLocalRay(r), triangle);
+    hit.part = triangle;
+    return hit;
+}
+
+Intersection Mesh::ShadeIntersection(const Ray &r, const GeometryHit &hit)
+{
+    //The triangle shades in object space, where its point is the one SetNormalTangentBitangent needs
+    Intersection isx = hit.part->ShadeIntersection(ToLocalRay(r), GeometryHit(hit.t));
+    SetNormalTangentBitangent(isx.point, isx);
+    isx.point = hit.t * r.direction + r.origin;
+    isx.object_hit = this;
+    return isx;
 }
 
 void Mesh::SetMaterial(Material *m)
@@ -239,28 +275,22 @@ glm::vec2 Triangle::GetUVCoordinates(const glm::vec3 &point)
 
 void Triangle::SetNormalTangentBitangent(const glm::vec3& point_local, Intersection &isx)
 {
-    glm::vec3 up(0,1,0);
     glm::vec3 normal_local = GetNormal(point_local);
-    glm::vec3 tangent_local = glm::normalize(glm::cross(up,normal_local));
-    glm::vec3 bitangent_local = glm::normalize(glm::cross(normal_local,tangent_local));
 
-    // transform to world coordinates
-    isx.normal = glm::normalize(glm::vec3(transform.invTransT() * glm::vec4(normal_local,0.0f)));
-    isx.tangent = glm::normalize(glm::vec3(transform.T() * glm::vec4(tangent_local,0.0f)));
-    isx.bitangent = glm::normalize(glm::vec3(transform.T() * glm::vec4(bitangent_local,0.0f)));
+    // transform to world coordinates, the tangent frame is built from the world normal
+    // triangles of a Mesh have an identity transform, so there is nothing to transform
+    if(transform.IsIdentity())
+        isx.SetNormal(normal_local);
+    else
+        isx.SetNormal(glm::normalize(transform.TransformNormal(normal_local)));
 }
 
 void Mesh::SetNormalTangentBitangent(const glm::vec3 &point_local, Intersection &isx)
 {
-    glm::vec3 up(0,1,0);
     glm::vec3 normal_local = ((Triangle*)isx.object_hit)->GetNormal(point_local);
-    glm::vec3 tangent_local = glm::normalize(glm::cross(up,normal_local));
-    glm::vec3 bitangent_local = glm::normalize(glm::cross(normal_local,tangent_local));
 
-    // transform to world coordinates
-    isx.normal = glm::normalize(glm::vec3(transform.invTransT() * glm::vec4(normal_local,0.0f)));
-    isx.tangent = glm::normalize(glm::vec3(transform.T() * glm::vec4(tangent_local,0.0f)));
-    isx.bitangent = glm::normalize(glm::vec3(transform.T() * glm::vec4(bitangent_local,0.0f)));
+    // transform to world coordinates, the tangent frame is built from the world normal
+    isx.SetNormal(glm::normalize(transform.TransformNormal(normal_local)));
 }
 
 void Mesh::LoadOBJ(const QStringRef &filename, const QStringRef &local_path)
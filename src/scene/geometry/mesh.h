@@ -2,6 +2,7 @@
 #include <scene/geometry/geometry.h>
 #include <openGL/drawable.h>
 #include <QList>
+#include <vector>
 
 class Triangle : public Geometry
 {
@@ -10,6 +11,8 @@ public:
     Triangle(const glm::vec3 &p1, const glm::vec3 &p2, const glm::vec3 &p3, const glm::vec3 &n1, const glm::vec3 &n2, const glm::vec3 &n3);
     Triangle(const glm::vec3 &p1, const glm::vec3 &p2, const glm::vec3 &p3, const glm::vec3 &n1, const glm::vec3 &n2, const glm::vec3 &n3, const glm::vec2 &t1, const glm::vec2 &t2, const glm::vec2 &t3);
     Intersection GetIntersection(Ray r);
+    virtual GeometryHit GetIntersectionT(const Ray &r);
+    virtual Intersection ShadeIntersection(const Ray &r, const GeometryHit &hit);
     virtual glm::vec2 GetUVCoordinates(const glm::vec3 &point);
     virtual glm::vec3 ComputeNormal(const glm::vec3 &P);
 
@@ -42,6 +45,8 @@ class Mesh : public Geometry
 public:
     Mesh() {bvhTree = NULL;}
     Intersection GetIntersection(Ray r);
+    virtual GeometryHit GetIntersectionT(const Ray &r);
+    virtual Intersection ShadeIntersection(const Ray &r, const GeometryHit &hit);
     void SetMaterial(Material *m);
     void create();
     void LoadOBJ(const QStringRef &filename, const QStringRef &local_path);
@@ -58,4 +63,9 @@ public:
     BVHNode* bvhTree;
 
     QList<Triangle*> faces;
+
+    //Running sum of the faces' world-space areas, normalized to end at 1. Built by ComputeArea.
+    std::vector<float> area_cdf;
+    //Picks a face with probability proportional to its area and rescales u to [0,1) for reuse inside that face
+    Triangle* SampleFace(float &u) const;
 };
@@ -63,7 +63,8 @@ void Sphere::ComputeArea()
 Intersection Sphere::RandomSampleOnSurface(const float &u, const float &v)
 {
 
-    float costheta = glm::pow(u, 0.5f);
+    //Uniform over the whole sphere, so the area pdf is 1/area
+    float costheta = 1.0f - 2.0f * u;
     float sintheta = glm::sqrt(glm::max(0.0f, 1.0f - costheta*costheta));
     float phi = v * 2 * PI;
     float r = 0.5f;
@@ -100,15 +101,11 @@ Intersection Sphere::GetSurfaceSample(const float &u1, const float &u2, const gl
     glm::vec4 normalL(normal3,0);
     glm::vec2 uv = this->GetUVCoordinates(glm::vec3(pointL));
     glm::vec3 color = Material::GetImageColor(uv, this->material->texture);
-    glm::vec3 T = glm::normalize(glm::cross(glm::vec3(0,1,0), glm::vec3(normalL)));
-    glm::vec3 B = glm::cross(glm::vec3(normalL), T);
 
     Intersection result;
     result.point = glm::vec3(transform.T() * pointL);
-    result.normal = glm::normalize(glm::vec3(transform.invTransT() * normalL));
+    result.SetNormal(glm::normalize(glm::vec3(transform.invTransT() * normalL)));
     result.texture_color = color;
-    result.tangent = glm::normalize(glm::vec3(transform.T() * glm::vec4(T, 0)));
-    result.bitangent = glm::normalize(glm::vec3(transform.T() * glm::vec4(B, 0)));
     result.object_hit = this;
     return result;
 }
@@ -133,53 +130,56 @@ glm::vec3 Sphere::ComputeNormal(const glm::vec3 &P)
 
 Intersection Sphere::GetIntersection(Ray r)
 {
-    //Transform the ray
-    Ray r_loc = r.GetTransformedCopy(transform.invT());
-    Intersection result;
+    GeometryHit hit = GetIntersectionT(r);
+    if(hit.t < 0)
+        return Intersection();
+    return ShadeIntersection(r, hit);
+}
 
-    float A = pow(r_loc.direction[0], 2) + pow(r_loc.direction[1], 2) + pow(r_loc.direction[2], 2);
-    float B = 2*(r_loc.direction[0]*r_loc.origin[0] + r_loc.direction[1] * r_loc.origin[1] + r_loc.direction[2] * r_loc.origin[2]);
-    float C = pow(r_loc.origin[0], 2) + pow(r_loc.origin[1], 2) + pow(r_loc.origin[2], 2) - 0.25f;//Radius is 0.5f
+GeometryHit Sphere::GetIntersectionT(const Ray &r)
+{
+    //Transform the ray, t against r_loc is also t against r
+    Ray r_loc = ToLocalRay(r);
+
+    float A = glm::dot(r_loc.direction, r_loc.direction);
+    float B = 2*glm::dot(r_loc.direction, r_loc.origin);
+    float C = glm::dot(r_loc.origin, r_loc.origin) - 0.25f;//Radius is 0.5f
     float discriminant = B*B - 4*A*C;
     //If the discriminant is negative, then there is no real root
-    if(discriminant < 0){
-        return result;
-    }
-    float t = (-B - sqrt(discriminant))/(2*A);
+    if(discriminant < 0)
+        return -1;
+
+    float root = sqrt(discriminant);
+    float t = (-B - root)/(2*A);
     if(t < 0)
     {
-        t = (-B + sqrt(discriminant))/(2*A);
+        t = (-B + root)/(2*A);
     }
-    if(t >= 0)
-    {
-        glm::vec4 P = glm::vec4(r_loc.origin + t*r_loc.direction, 1);
-        result.point = glm::vec3(transform.T() * P);
+    return t >= 0 ? t : -1;
+}
 
-        glm::vec2 uv = GetUVCoordinates(glm::vec3(P));
-        result.normal = glm::normalize(glm::vec3(transform.invTransT() * (P - glm::vec4(0,0,0,1))));
-        result.texture_color = Material::GetImageColor(uv, material->texture);
-        result.object_hit = this;
-        result.t = glm::length(result.point - r.origin);
+Intersection Sphere::ShadeIntersection(const Ray &r, const GeometryHit &hit)
+{
+    Ray r_loc = ToLocalRay(r);
+    glm::vec3 P = r_loc.origin + hit.t*r_loc.direction;
 
-        // Store the tangent and bitangent
-        SetNormalTangentBitangent(glm::vec3(P),result);
+    Intersection result;
+    result.point = r.origin + hit.t*r.direction;
+    result.texture_color = Material::GetImageColor(GetUVCoordinates(P), material->texture);
+    result.object_hit = this;
+    result.t = hit.t;
 
-        return result;
-    }
+    // Store the tangent and bitangent
+    SetNormalTangentBitangent(P,result);
     return result;
 }
 
 void Sphere::SetNormalTangentBitangent(const glm::vec3& point_local, Intersection& isx)
 {
-    glm::vec3 up(0,1,0);
     glm::vec3 normal_local = glm::normalize(point_local);
-    glm::vec3 tangent_local = glm::normalize(glm::cross(up,normal_local));
-    glm::vec3 bitangent_local = glm::normalize(glm::cross(normal_local,tangent_local));
 
-    // transform to world coordinates
-    isx.normal = glm::normalize(glm::vec3(transform.invTransT() * glm::vec4(normal_local,0.0f)));
-    isx.tangent = glm::normalize(glm::vec3(transform.T() * glm::vec4(tangent_local,0.0f)));
-    isx.bitangent = glm::normalize(glm::vec3(transform.T() * glm::vec4(bitangent_local,0.0f)));
+    // transform to world coordinates, the tangent frame is built from the world normal
+    isx.SetNormal(glm::normalize(transform.TransformNormal(normal_local)));
 }
 
 glm::vec2 Sphere::GetUVCoordinates(const glm::vec3 &point)
@@ -8,6 +8,8 @@ class Sphere : public Geometry
 {
 public:
     Intersection GetIntersection(Ray r);
+    virtual GeometryHit GetIntersectionT(const Ray &r);
+    virtual Intersection ShadeIntersection(const Ray &r, const GeometryHit &hit);
     virtual glm::vec2 GetUVCoordinates(const glm::vec3 &point);
     virtual glm::vec3 ComputeNormal(const glm::vec3 &P);
     void create();
@@ -36,39 +36,47 @@ Intersection SquarePlane::RandomSampleOnSurface(const float &u, const float &v)
 
 void SquarePlane::SetNormalTangentBitangent(const glm::vec3 &point_local, Intersection &isx)
 {
-    glm::vec3 up(0,1,0);
-
     glm::vec3 normal_local = glm::vec3(0,0,1);
-    glm::vec3 tangent_local = glm::normalize(glm::cross(up,normal_local));
-    glm::vec3 bitangent_local = glm::normalize(glm::cross(normal_local,tangent_local));
 
-    // transform to world coordinates
-    isx.normal = glm::normalize(glm::vec3(transform.invTransT() * glm::vec4(normal_local,0.0f)));
-    isx.tangent = glm::normalize(glm::vec3(transform.T() * glm::vec4(tangent_local,0.0f)));
-    isx.bitangent = glm::normalize(glm::vec3(transform.T() * glm::vec4(bitangent_local,0.0f)));
+    // transform to world coordinates, the tangent frame is built from the world normal
+    isx.SetNormal(glm::normalize(transform.TransformNormal(normal_local)));
 }
 
 Intersection SquarePlane::GetIntersection(Ray r)
 {
-    //Transform the ray
-    Ray r_loc = r.GetTransformedCopy(transform.invT());
-    Intersection result;
+    GeometryHit hit = GetIntersectionT(r);
+    if(hit.t < 0)
+        return Intersection();
+    return ShadeIntersection(r, hit);
+}
 
-    //Ray-plane intersection
-    float t = glm::dot(glm::vec3(0,0,1), (glm::vec3(0.5f, 0.5f, 0) - r_loc.origin)) / glm::dot(glm::vec3(0,0,1), r_loc.direction);
-    glm::vec4 P = glm::vec4(t * r_loc.direction + r_loc.origin, 1);
+GeometryHit SquarePlane::GetIntersectionT(const Ray &r)
+{
+    //Transform the ray, t against r_loc is also t against r
+    Ray r_loc = ToLocalRay(r);
+
+    //Ray-plane intersection against z = 0. A ray parallel to the plane gives inf or nan, which fails the bounds test
+    float t = -r_loc.origin.z / r_loc.direction.z;
+    glm::vec3 P = r_loc.origin + t*r_loc.direction;
     //Check that P is within the bounds of the square
     if(t > 0 && P.x >= -0.5f && P.x <= 0.5f && P.y >= -0.5f && P.y <= 0.5f)
-    {
-        result.point = glm::vec3(transform.T() * P);
-        result.object_hit = this;
-        result.t = glm::distance(result.point, r.origin);
-        result.texture_color = Material::GetImageColorInterp(GetUVCoordinates(glm::vec3(P)), material->texture);
-
-        //Store the tangent and bitangent
-        SetNormalTangentBitangent(glm::vec3(P), result);
-        return result;
-    }
+        return t;
+    return -1;
+}
+
+Intersection SquarePlane::ShadeIntersection(const Ray &r, const GeometryHit &hit)
+{
+    Ray r_loc = ToLocalRay(r);
+    glm::vec3 P = r_loc.origin + hit.t*r_loc.direction;
+
+    Intersection result;
+    result.point = r.origin + hit.t*r.direction;
+    result.object_hit = this;
+    result.t = hit.t;
+    result.texture_color = Material::GetImageColorInterp(GetUVCoordinates(P), material->texture);
+
+    //Store the tangent and bitangent
+    SetNormalTangentBitangent(P, result);
     return result;
 }
 
@@ -1,4 +1,5 @@
 #include <scene/materials/bxdfs/blinnmicrofacetbxdf.h>
+#include <scene/materials/bxdfs/bxdfsimd.h>
 
 glm::vec3 BlinnMicrofacetBxDF::EvaluateScatteredEnergy(const glm::vec3 &wo, const glm::vec3 &wi, float &pdf) const
 {
@@ -68,3 +69,77 @@ float BlinnMicrofacetBxDF::PDF(const glm::vec3 &wo, const glm::vec3 &wi) const
 
     return pdf;
 }
+
+
+void BlinnMicrofacetBxDF::SampleAndEvaluateBatch(BxDFSampleBatch &batch) const
+{
+    unsigned int i = 0;
+#if defined(__SSE2__)
+    using namespace bxdfsimd;
+    //The kernel folds in F = 1. Any other Fresnel term takes the single-sample path.
+    if(dynamic_cast<FresnelNo*>(fresnel) != NULL)
+    {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 exp = _mm_set1_ps(exponent);
+        const __m128 inv_exp1 = _mm_set1_ps(1.0f / (exponent + 1.0f));
+        const __m128 pdf_scale = _mm_set1_ps((exponent + 1.0f) / (2.0f * PI * 4.0f));
+        const __m128 d_scale = _mm_set1_ps((exponent + 2.0f) / (2.0f * PI));
+        for(; i + 4 <= batch.Size(); i += 4)
+        {
+            __m128 wo_x = _mm_loadu_ps(&batch.wo_x[i]);
+            __m128 wo_y = _mm_loadu_ps(&batch.wo_y[i]);
+            __m128 wo_z = _mm_loadu_ps(&batch.wo_z[i]);
+
+            //Half vector around the normal, on wo's side
+            __m128 costheta = Pow(_mm_loadu_ps(&batch.u1[i]), inv_exp1);
+            __m128 sintheta = _mm_sqrt_ps(_mm_max_ps(zero, _mm_sub_ps(one, _mm_mul_ps(costheta, costheta))));
+            __m128 sinphi, cosphi;
+            SinCos(_mm_mul_ps(_mm_loadu_ps(&batch.u2[i]), _mm_set1_ps(TWO_PI)), sinphi, cosphi);
+            __m128 flip = _mm_and_ps(_mm_cmplt_ps(_mm_mul_ps(wo_z, costheta), zero), _mm_set1_ps(-0.0f));
+            __m128 wh_x = _mm_xor_ps(_mm_mul_ps(sintheta, cosphi), flip);
+            __m128 wh_y = _mm_xor_ps(_mm_mul_ps(sintheta, sinphi), flip);
+            __m128 wh_z = _mm_xor_ps(costheta, flip);
+
+            //wi is wo reflected about wh
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(wo_x, wh_x), _mm_mul_ps(wo_y, wh_y)), _mm_mul_ps(wo_z, wh_z));
+            __m128 d2 = _mm_add_ps(d, d);
+            __m128 wi_x = _mm_sub_ps(_mm_mul_ps(d2, wh_x), wo_x);
+            __m128 wi_y = _mm_sub_ps(_mm_mul_ps(d2, wh_y), wo_y);
+            __m128 wi_z = _mm_sub_ps(_mm_mul_ps(d2, wh_z), wo_z);
+            _mm_storeu_ps(&batch.wi_x[i], wi_x);
+            _mm_storeu_ps(&batch.wi_y[i], wi_y);
+            _mm_storeu_ps(&batch.wi_z[i], wi_z);
+
+            //From here on as EvaluateScatteredEnergy and PDF, with the half vector rebuilt from wo + wi
+            __m128 h_x = _mm_add_ps(wo_x, wi_x);
+            __m128 h_y = _mm_add_ps(wo_y, wi_y);
+            __m128 h_z = _mm_add_ps(wo_z, wi_z);
+            __m128 inv_len = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(h_x, h_x), _mm_mul_ps(h_y, h_y)), _mm_mul_ps(h_z, h_z))));
+            h_x = _mm_mul_ps(h_x, inv_len);
+            h_y = _mm_mul_ps(h_y, inv_len);
+            h_z = _mm_mul_ps(h_z, inv_len);
+            __m128 wo_h = _mm_add_ps(_mm_add_ps(_mm_mul_ps(wo_x, h_x), _mm_mul_ps(wo_y, h_y)), _mm_mul_ps(wo_z, h_z));
+            __m128 cos_h = Abs(h_z);
+            __m128 pow_h = Pow(cos_h, exp);
+
+            __m128 pdf_valid = _mm_and_ps(_mm_cmpgt_ps(wo_h, zero), _mm_cmpge_ps(wo_z, zero));
+            _mm_storeu_ps(&batch.pdf[i], _mm_and_ps(pdf_valid, _mm_div_ps(_mm_mul_ps(pdf_scale, pow_h), wo_h)));
+
+            //Both directions strictly above the surface, otherwise nothing is reflected
+            __m128 f_valid = _mm_and_ps(_mm_cmpgt_ps(wo_z, zero), _mm_cmpgt_ps(wi_z, zero));
+            __m128 D = _mm_mul_ps(d_scale, pow_h);
+            __m128 h_2z = _mm_div_ps(_mm_add_ps(h_z, h_z), wo_h);
+            __m128 M = Abs(_mm_mul_ps(h_2z, wo_z));
+            __m128 S = Abs(_mm_mul_ps(h_2z, wi_z));
+            __m128 G = _mm_min_ps(one, _mm_min_ps(M, S));
+            __m128 brdf = _mm_div_ps(_mm_mul_ps(D, G), _mm_mul_ps(_mm_set1_ps(4.0f), _mm_mul_ps(wi_z, wo_z)));
+            brdf = _mm_and_ps(f_valid, brdf);
+            _mm_storeu_ps(&batch.f_r[i], _mm_mul_ps(brdf, _mm_set1_ps(reflection_color.r)));
+            _mm_storeu_ps(&batch.f_g[i], _mm_mul_ps(brdf, _mm_set1_ps(reflection_color.g)));
+            _mm_storeu_ps(&batch.f_b[i], _mm_mul_ps(brdf, _mm_set1_ps(reflection_color.b)));
+        }
+    }
+#endif
+    SampleAndEvaluateBatchScalar(batch, i);
+}
@@ -8,6 +8,32 @@ glm::vec3 BxDF::SampleAndEvaluateScatteredEnergy(const glm::vec3 &wo, glm::vec3
     return glm::vec3(0);
 }
 
+void BxDFSampleBatch::Resize(unsigned int n)
+{
+    wo_x.resize(n); wo_y.resize(n); wo_z.resize(n);
+    u1.resize(n); u2.resize(n);
+    wi_x.resize(n); wi_y.resize(n); wi_z.resize(n);
+    f_r.resize(n); f_g.resize(n); f_b.resize(n);
+    pdf.resize(n);
+}
+
+void BxDF::SampleAndEvaluateBatch(BxDFSampleBatch &batch) const
+{
+    SampleAndEvaluateBatchScalar(batch, 0);
+}
+
+void BxDF::SampleAndEvaluateBatchScalar(BxDFSampleBatch &batch, unsigned int begin) const
+{
+    for(unsigned int i = begin; i < batch.Size(); i++)
+    {
+        glm::vec3 wi(0);
+        batch.pdf[i] = 0;
+        glm::vec3 f = SampleAndEvaluateScatteredEnergy(glm::vec3(batch.wo_x[i], batch.wo_y[i], batch.wo_z[i]), wi, batch.u1[i], batch.u2[i], batch.pdf[i]);
+        batch.wi_x[i] = wi.x; batch.wi_y[i] = wi.y; batch.wi_z[i] = wi.z;
+        batch.f_r[i] = f.r; batch.f_g[i] = f.g; batch.f_b[i] = f.b;
+    }
+}
+
 glm::vec3 BxDF::EvaluateHemisphereScatteredEnergy(const glm::vec3 &wo, int num_samples, const glm::vec2* samples) const
 {
     //TODO
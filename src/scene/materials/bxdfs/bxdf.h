@@ -1,5 +1,6 @@
 #pragma once
 #include <la.h>
+#include <vector>
 
 class Fresnel
 {
@@ -42,6 +43,22 @@ enum BxDFType {
                             BSDF_ALL_TRANSMISSION
 };
 
+//Structure-of-arrays inputs and outputs for sampling one BxDF at many points in a single call.
+//Each component lives in its own contiguous array so a kernel can load several samples into one register.
+struct BxDFSampleBatch
+{
+    void Resize(unsigned int n);
+    unsigned int Size() const {return wo_x.size();}
+
+    //Inputs: local-space wo and the two random numbers of each sample
+    std::vector<float> wo_x, wo_y, wo_z;
+    std::vector<float> u1, u2;
+    //Outputs, as SampleAndEvaluateScatteredEnergy would return them
+    std::vector<float> wi_x, wi_y, wi_z;
+    std::vector<float> f_r, f_g, f_b;
+    std::vector<float> pdf;
+};
+
 //An abstract class from which specific BRDF and BTDF types inherit
 //Contains functions necessary for the evaluation of reflected/transmitted light energy
 //All functions using wo and wi are assumed to operate around a surface normal of <0 0 1>
@@ -61,6 +78,12 @@ public:
     //It "returns" wi by storing it in the supplied reference to wi. Likewise, it "returns" the value of its PDF given wi and wo in the reference to pdf.
     virtual glm::vec3 SampleAndEvaluateScatteredEnergy(const glm::vec3 &wo, glm::vec3 &wi_ret, float rand1, float rand2, float &pdf_ret) const;
 
+    //Runs SampleAndEvaluateScatteredEnergy over every sample in batch.
+    //The default implementation loops over the single-sample version; subclasses with a vectorized kernel override it.
+    virtual void SampleAndEvaluateBatch(BxDFSampleBatch &batch) const;
+    //The single-sample loop over batch from begin on, for whatever a vectorized kernel leaves over
+    void SampleAndEvaluateBatchScalar(BxDFSampleBatch &batch, unsigned int begin) const;
+
     //Given a set of pairs of random numbers (samples), create N sample points on the hemisphere and evaluate the BxDF given wo and each of these sampled wi.
     //Equivalent to the RHO term in Monte Carlo path tracing
     //The default implementation generates wi based on cosine-weighted hemisphere sampling
@@ -76,6 +99,10 @@ public:
 
     inline bool MatchesFlags(const BxDFType& flags) {return (flags & type) == type;}
 
+    //True for lobes that scatter into a single direction (mirrors, refraction). They are only reached by sampling,
+    //which returns F already divided by the pdf, and add nothing when a Material evaluates a given wi.
+    virtual bool IsDelta() const {return false;}
+
     bool isPerfectReflective(const glm::vec3& wo,const glm::vec3& wi) const ;
 
     glm::vec3 SphericalDirection(float sintheta,float costheta,float phi) const;
@@ -1,10 +1,11 @@
 #include <scene/materials/bxdfs/lambertBxDF.h>
+#include <scene/materials/bxdfs/bxdfsimd.h>
 
 glm::vec3 LambertBxDF::EvaluateScatteredEnergy(const glm::vec3 &wo, const glm::vec3 &wi,float &pdf) const
 {
     pdf = PDF(wo,wi);
     // take the material's base color and divided by pi
-    if(wo.z < 0)
+    if(wo.z < 0 || wo.z * wi.z < 0)
         return glm::vec3(0);
     else
         return this->diffuse_color / PI;
@@ -34,6 +35,38 @@ float LambertBxDF::PDF(const glm::vec3 &wo, const glm::vec3 &wi) const
     if(wo.z < 0 || wo.z * wi.z < 0)
         return 0;
     else
-        return 1.0f / PI * glm::abs(wo.z);
+        return 1.0f / PI * glm::abs(wi.z);
+
+}
+
+void LambertBxDF::SampleAndEvaluateBatch(BxDFSampleBatch &batch) const
+{
+    unsigned int i = 0;
+#if defined(__SSE2__)
+    using namespace bxdfsimd;
+    const __m128 zero = _mm_setzero_ps();
+    for(; i + 4 <= batch.Size(); i += 4)
+    {
+        __m128 wo_z = _mm_loadu_ps(&batch.wo_z[i]);
+
+        __m128 costheta = _mm_sqrt_ps(_mm_loadu_ps(&batch.u1[i]));
+        __m128 sintheta = _mm_sqrt_ps(_mm_max_ps(zero, _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(costheta, costheta))));
+        __m128 sinphi, cosphi;
+        SinCos(_mm_mul_ps(_mm_loadu_ps(&batch.u2[i]), _mm_set1_ps(TWO_PI)), sinphi, cosphi);
+
+        //wi starts in the upper hemisphere, so it is flipped exactly when wo is below.
+        //Below the surface nothing is reflected, as in EvaluateScatteredEnergy.
+        __m128 below = _mm_cmplt_ps(wo_z, zero);
+        __m128 flip = _mm_and_ps(below, _mm_set1_ps(-0.0f));
+        _mm_storeu_ps(&batch.wi_x[i], _mm_xor_ps(_mm_mul_ps(sintheta, cosphi), flip));
+        _mm_storeu_ps(&batch.wi_y[i], _mm_xor_ps(_mm_mul_ps(sintheta, sinphi), flip));
+        _mm_storeu_ps(&batch.wi_z[i], _mm_xor_ps(costheta, flip));
 
+        _mm_storeu_ps(&batch.pdf[i], _mm_andnot_ps(below, _mm_mul_ps(costheta, _mm_set1_ps(INV_PI))));
+        _mm_storeu_ps(&batch.f_r[i], _mm_andnot_ps(below, _mm_set1_ps(diffuse_color.r * INV_PI)));
+        _mm_storeu_ps(&batch.f_g[i], _mm_andnot_ps(below, _mm_set1_ps(diffuse_color.g * INV_PI)));
+        _mm_storeu_ps(&batch.f_b[i], _mm_andnot_ps(below, _mm_set1_ps(diffuse_color.b * INV_PI)));
+    }
+#endif
+    SampleAndEvaluateBatchScalar(batch, i);
 }
@@ -11,6 +11,8 @@ public:
     virtual glm::vec3 EvaluateScatteredEnergy(const glm::vec3 &wo, const glm::vec3 &wi,float &pdf) const;
     virtual glm::vec3 EvaluateHemisphereScatteredEnergy(const glm::vec3 &wo, int num_samples, const glm::vec2 *samples) const;
     virtual glm::vec3 SampleAndEvaluateScatteredEnergy(const glm::vec3 &wo, glm::vec3 &wi_ret, float rand1, float rand2, float &pdf_ret) const;
+    //Four samples per SSE register, with the scalar version for the remainder
+    virtual void SampleAndEvaluateBatch(BxDFSampleBatch &batch) const;
     virtual float PDF(const glm::vec3 &wo, const glm::vec3 &wi) const;
 
 //Member variables
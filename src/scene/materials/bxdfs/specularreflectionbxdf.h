@@ -12,6 +12,7 @@ public:
     virtual glm::vec3 EvaluateHemisphereScatteredEnergy(const glm::vec3 &wo, int num_samples, const glm::vec2 *samples) const;
     virtual glm::vec3 SampleAndEvaluateScatteredEnergy(const glm::vec3 &wo, glm::vec3 &wi_ret, float rand1, float rand2, float &pdf_ret) const;
     virtual float PDF(const glm::vec3 &wo, const glm::vec3 &wi) const;
+    virtual bool IsDelta() const {return true;}
 
 //Member variables
     glm::vec3 reflection_color;
@@ -23,6 +23,7 @@ public:
 
     virtual glm::vec3 SampleAndEvaluateScatteredEnergy(const glm::vec3 &wo, glm::vec3 &wi_ret, float rand1, float rand2, float &pdf_ret) const;
     virtual float PDF(const glm::vec3 &wo, const glm::vec3 &wi) const;
+    virtual bool IsDelta() const {return true;}
 
     glm::vec3 trans_color;
 };
@@ -1,5 +1,6 @@
 #include <scene/materials/material.h>
 #include <QColor>
+#include <QThreadStorage>
 #include <math.h>
 
 Material::Material() :
@@ -11,6 +12,7 @@ Material::Material() :
 
 Material::Material(const glm::vec3 &color):
     name("MATERIAL"),
+    id(-1),
     bxdfs(),
     is_light_source(false),
     base_color(color),
@@ -20,70 +22,176 @@ Material::Material(const glm::vec3 &color):
     normal_map = NULL;
 }
 
+//One generator per render thread, seeded once, rather than a time-seeded one per call:
+//calls within the same clock tick would otherwise repeat the same numbers
+static std::mt19937 &ThreadGenerator()
+{
+    static QThreadStorage<std::mt19937*> generators;
+    if(!generators.hasLocalData())
+        generators.setLocalData(new std::mt19937(std::random_device()()));
+    return *generators.localData();
+}
+
 glm::vec3 Material::EvaluateScatteredEnergy(const Intersection &isx, const glm::vec3 &woW, const glm::vec3 &wiW, float &pdf, BxDFType flags)
 {
-    std::mt19937 generator(std::chrono::system_clock::now().time_since_epoch().count());
-    std::uniform_real_distribution<float> uniform_distribution(0.0f,1.0f);
+    return base_color * isx.texture_color * EvaluateBxDFs(woW, wiW, pdf, flags);
+}
 
-    int matchedNumber = 0;
-    for(int i=0;i<bxdfs.size();i++)
-        if(bxdfs[i]->MatchesFlags(flags))
-            matchedNumber ++;
+glm::vec3 Material::SampleAndEvaluateScatteredEnergy(const Intersection &isx, const glm::vec3 &woW, glm::vec3 &wiW_ret, float &pdf_ret, BxDFType flags)
+{
+    std::mt19937 &generator = ThreadGenerator();
+    std::uniform_real_distribution<float> uniform_distribution(0.0f,1.0f);
+    float rand0 = uniform_distribution(generator);
+    float rand1 = uniform_distribution(generator);
+    float rand2 = uniform_distribution(generator);
+    return SampleAndEvaluateScatteredEnergy(isx, woW, wiW_ret, rand0, rand1, rand2, pdf_ret, flags);
+}
 
-    if(matchedNumber == 0)
+glm::vec3 Material::SampleAndEvaluateScatteredEnergy(const Intersection &isx, const glm::vec3 &woW, glm::vec3 &wiW_ret, float rand0, float rand1, float rand2, float &pdf_ret, BxDFType flags)
+{
+    pdf_ret = 0;
+    int index = PickBxDF(rand0, flags);
+    if(index < 0)
         return glm::vec3(0);
 
-    // randomly choose a BxDF from bxdf list, and return the EvaluateSctteredEnergy() of that bxdf with w_o and w_i
-    int count = uniform_distribution(generator) * float(matchedNumber);
-    int index=0;
+    glm::vec3 F = bxdfs[index]->SampleAndEvaluateScatteredEnergy(woW, wiW_ret, rand1, rand2, pdf_ret);
+    //A delta lobe's F is already over its pdf, and picking it with probability w scales both by w
+    if(bxdfs[index]->IsDelta() || pdf_ret <= 0)
+        return base_color * isx.texture_color * F;
 
+    //Otherwise wi could have come from any non-delta lobe: return the mixture's f and pdf
+    float w = BxDFWeight(index) / MatchedWeight(flags);
+    float pdf_rest;
+    glm::vec3 f_rest = EvaluateBxDFs(woW, wiW_ret, pdf_rest, flags, index);
+    pdf_ret = w * pdf_ret + pdf_rest;
+    return base_color * isx.texture_color * (w * F + f_rest);
+}
+
+float Material::BxDFWeight(int index) const
+{
+    return 1.0f;
+}
+
+float Material::MatchedWeight(BxDFType flags) const
+{
+    float total = 0;
     for(int i=0;i<bxdfs.size();i++)
         if(bxdfs[i]->MatchesFlags(flags))
-        {
-            if(count == 0)
-            {
-                index = i;
-                break;
-            }
-            count -- ;
-        }
+            total += BxDFWeight(i);
+    return total;
+}
 
-    return base_color * isx.texture_color * bxdfs[index]->EvaluateScatteredEnergy(woW, wiW, pdf);
+bool Material::HasNonDelta(BxDFType flags) const
+{
+    for(int i=0;i<bxdfs.size();i++)
+        if(bxdfs[i]->MatchesFlags(flags) && !bxdfs[i]->IsDelta() && BxDFWeight(i) > 0)
+            return true;
+    return false;
 }
 
-glm::vec3 Material::SampleAndEvaluateScatteredEnergy(const Intersection &isx, const glm::vec3 &woW, glm::vec3 &wiW_ret, float &pdf_ret, BxDFType flags)
+glm::vec3 Material::EvaluateBxDFs(const glm::vec3 &wo, const glm::vec3 &wi, float &pdf, BxDFType flags, int skip) const
 {
-    std::mt19937 generator(std::chrono::system_clock::now().time_since_epoch().count());
-    std::uniform_real_distribution<float> uniform_distribution(0.0f,1.0f);
+    glm::vec3 f(0);
+    pdf = 0;
+    float total = MatchedWeight(flags);
+    if(total <= 0)
+        return f;
 
-    int matchedNumber = 0;
     for(int i=0;i<bxdfs.size();i++)
-        if(bxdfs[i]->MatchesFlags(flags))
-            matchedNumber ++;
+    {
+        if(i == skip || !bxdfs[i]->MatchesFlags(flags) || bxdfs[i]->IsDelta())
+            continue;
+        float w = BxDFWeight(i) / total;
+        float pdf_i;
+        f += w * bxdfs[i]->EvaluateScatteredEnergy(wo, wi, pdf_i);
+        pdf += w * pdf_i;
+    }
+    return f;
+}
 
-    if(matchedNumber == 0)
-        return glm::vec3(0);
+void MaterialSampleBatch::Resize(unsigned int n)
+{
+    wo.resize(n);
+    texture_color.resize(n);
+    u0.resize(n); u1.resize(n); u2.resize(n);
+    wi.resize(n);
+    F.resize(n);
+    pdf.resize(n);
+}
 
-    // randomly choose a BxDF from bxdf list, and return the EvaluateSctteredEnergy() of that bxdf with w_o and w_i
-    int count = uniform_distribution(generator) * float(matchedNumber);
-    int index=0;
+int Material::PickBxDF(float u, BxDFType flags) const
+{
+    float total = MatchedWeight(flags);
+    if(total <= 0)
+        return -1;
 
+    float x = u * total;
+    float sum = 0.0f;
+    int last = -1;
     for(int i=0;i<bxdfs.size();i++)
         if(bxdfs[i]->MatchesFlags(flags))
         {
+            sum += BxDFWeight(i);
+            last = i;
+            if(x < sum)
+                return i;
+        }
+    //Rounding can leave x at the very top of the range
+    return last;
+}
 
-            if(count == 0)
+void Material::SampleAndEvaluateBatch(MaterialSampleBatch &batch, BxDFType flags)
+{
+    std::vector<std::vector<unsigned int>> members(bxdfs.size());
+    for(unsigned int i = 0; i < batch.Size(); i++)
+    {
+        batch.wi[i] = glm::vec3(0);
+        batch.F[i] = glm::vec3(0);
+        batch.pdf[i] = 0;
+        int index = PickBxDF(batch.u0[i], flags);
+        if(index >= 0)
+            members[index].push_back(i);
+    }
+
+    float total = MatchedWeight(flags);
+    BxDFSampleBatch lobe;
+    for(int b = 0; b < bxdfs.size(); b++)
+    {
+        const std::vector<unsigned int> &m = members[b];
+        if(m.empty())
+            continue;
+
+        //As the single-sample version: a non-delta lobe's samples get the mixture f and pdf when other non-delta lobes match
+        bool mixed = false;
+        if(!bxdfs[b]->IsDelta())
+            for(int j = 0; j < bxdfs.size(); j++)
+                mixed |= j != b && bxdfs[j]->MatchesFlags(flags) && !bxdfs[j]->IsDelta();
+        float w = BxDFWeight(b) / total;
+
+        lobe.Resize(m.size());
+        for(unsigned int k = 0; k < m.size(); k++)
+        {
+            const glm::vec3 &wo = batch.wo[m[k]];
+            lobe.wo_x[k] = wo.x; lobe.wo_y[k] = wo.y; lobe.wo_z[k] = wo.z;
+            lobe.u1[k] = batch.u1[m[k]];
+            lobe.u2[k] = batch.u2[m[k]];
+        }
+        bxdfs[b]->SampleAndEvaluateBatch(lobe);
+        for(unsigned int k = 0; k < m.size(); k++)
+        {
+            unsigned int i = m[k];
+            batch.wi[i] = glm::vec3(lobe.wi_x[k], lobe.wi_y[k], lobe.wi_z[k]);
+            glm::vec3 F(lobe.f_r[k], lobe.f_g[k], lobe.f_b[k]);
+            batch.pdf[i] = lobe.pdf[k];
+            if(mixed && batch.pdf[i] > 0)
             {
-                index = i;
-                break;
+                float pdf_rest;
+                F = w * F + EvaluateBxDFs(batch.wo[i], batch.wi[i], pdf_rest, flags, b);
+                batch.pdf[i] = w * batch.pdf[i] + pdf_rest;
             }
-            count -- ;
+            batch.F[i] = base_color * batch.texture_color[i] * F;
         }
-
-    float rand1 = uniform_distribution(generator);
-    float rand2 = uniform_distribution(generator);
-
-    return base_color * isx.texture_color * bxdfs[index]->SampleAndEvaluateScatteredEnergy(woW,wiW_ret,rand1,rand2,pdf_ret);
+    }
 }
 
 glm::vec3 Material::EvaluateHemisphereScatteredEnergy(const Intersection &isx, const glm::vec3 &wo, int num_samples, BxDFType flags)
@@ -9,6 +9,23 @@
 class Geometry;
 class Intersection;
 
+//Many BSDF samples at hits sharing one Material, in local normal coordinates.
+//u0 picks the BxDF, u1 and u2 sample it.
+struct MaterialSampleBatch
+{
+    void Resize(unsigned int n);
+    unsigned int Size() const {return wo.size();}
+
+    //Inputs
+    std::vector<glm::vec3> wo;
+    std::vector<glm::vec3> texture_color;
+    std::vector<float> u0, u1, u2;
+    //Outputs
+    std::vector<glm::vec3> wi;
+    std::vector<glm::vec3> F;
+    std::vector<float> pdf;
+};
+
 class Material
 {
 public:
@@ -18,11 +35,32 @@ public:
     virtual ~Material(){}
 
 //Functions
+    //The BxDFs matching flags act as one BSDF: a mixture in which each BxDF has probability BxDFWeight over the matched total.
+    //Evaluating returns the mixture's f and pdf summed over every non-delta BxDF, so the pdf agrees with what sampling produces.
+
     //Given an intersection with some Geometry, evaluate the scattered energy at isx given a world-space wo and wi for all BxDFs we contain that match the input flags
     virtual glm::vec3 EvaluateScatteredEnergy(const Intersection &isx, const glm::vec3 &woW, const glm::vec3 &wiW, float& pdf, BxDFType flags = BSDF_ALL) ;
 
     //Given an intersection with some Geometry, generate a world-space wi then evaluate the scattered energy along the world-space wo.
+    //Picks one BxDF by weight to sample wi, then returns the mixture's f and pdf at wi. A sampled delta lobe returns its own F and pdf.
     virtual glm::vec3 SampleAndEvaluateScatteredEnergy(const Intersection &isx, const glm::vec3 &woW, glm::vec3 &wiW_ret, float &pdf_ret, BxDFType flags = BSDF_ALL) ;
+    //As above with the random numbers supplied: rand0 picks the BxDF, rand1 and rand2 sample it
+    glm::vec3 SampleAndEvaluateScatteredEnergy(const Intersection &isx, const glm::vec3 &woW, glm::vec3 &wiW_ret, float rand0, float rand1, float rand2, float &pdf_ret, BxDFType flags = BSDF_ALL);
+
+    //SampleAndEvaluateScatteredEnergy over a whole batch. Samples are bucketed by the BxDF they pick,
+    //then each BxDF runs its batched kernel once over its bucket.
+    void SampleAndEvaluateBatch(MaterialSampleBatch &batch, BxDFType flags = BSDF_ALL);
+
+    //Index into bxdfs of the BxDF that u in [0,1) selects among those matching flags, in proportion to BxDFWeight, or -1 if none match
+    int PickBxDF(float u, BxDFType flags) const;
+    //Relative weight of bxdfs[index] in the mixture. Every BxDF weighs the same by default.
+    virtual float BxDFWeight(int index) const;
+    float MatchedWeight(BxDFType flags) const;
+    //Whether any non-delta BxDF matches flags, so that the material can be evaluated toward an arbitrary direction.
+    //Decides if a hit can be connected to or gather light, whichever lobe a sampled path happened to pick there.
+    bool HasNonDelta(BxDFType flags = BSDF_ALL) const;
+    //Weighted f and pdf summed over the non-delta BxDFs matching flags, leaving out bxdfs[skip], without base or texture color
+    glm::vec3 EvaluateBxDFs(const glm::vec3 &wo, const glm::vec3 &wi, float &pdf, BxDFType flags, int skip = -1) const;
 
     //Given an intersection with some Geometry and a number of samples to take, generate a set of N random vec2s.
     //Then, pass this information to each BxDF that matches the input flags and return their combined EHSE results
@@ -41,6 +79,7 @@ public:
 
 //Member Variables
     QString name;           //The name given in the scene XML file
+    int id;                 //Index in Scene::materials, written to the material ID AOV
     QList<BxDF*> bxdfs;     //The set of BxDFs to which this Material can refer when computing the color at a given intersection.
     bool is_light_source;   //A quick way to check if this material is that of a light source. If TRUE, the owning geometry is treated as an area light.
                             //Its color is base_color * texture, and its intensity is set by the intensity member variable
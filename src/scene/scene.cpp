@@ -12,6 +12,10 @@
 Scene::Scene()
 {
     this->sqrt_samples = 2;
+    this->pass_samples = 0;
+    this->checkpoint_interval = 0;
+    this->filter = NULL;
+    this->denoiser = NULL;
 }
 
 void Scene::SetCamera(const Camera &c)
@@ -58,6 +62,7 @@ void Scene::Clear()
     }
     objects.clear();
     lights.clear();
+    light_sampler.Clear();
     for(Material *m : materials)
     {
         delete m;
@@ -68,6 +73,12 @@ void Scene::Clear()
         delete b;
     }
     bxdfs.clear();
+    delete filter;
+    filter = NULL;
+    delete denoiser;
+    denoiser = NULL;
+    pass_samples = 0;
+    checkpoint_interval = 0;
     camera = Camera();
     film = Film();
 }
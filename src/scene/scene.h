@@ -5,6 +5,9 @@
 #include <raytracing/samplers/pixelsampler.h>
 #include <scene/geometry/geometry.h>
 #include <scene/materials/bxdfs/bxdf.h>
+#include <raytracing/lightsampler.h>
+#include <raytracing/filters/filter.h>
+#include <raytracing/denoiser.h>
 
 class Geometry;
 class Material;
@@ -17,10 +20,15 @@ public:
     QList<Material*> materials;
     QList<BxDF*> bxdfs;
     QList<Geometry*> lights;
+    LightSampler light_sampler;//Built from lights once they are loaded
     Camera camera;
     Film film;
+    Filter* filter;//Pixel reconstruction filter, NULL for a plain average of each pixel's samples
+    Denoiser* denoiser;//Run over the film once rendering is done, NULL to keep the raw image
 
     unsigned int sqrt_samples;//Read by MyGL and RenderThread when making PixelSamplers
+    unsigned int pass_samples;//Camera samples per pixel in each pass over the image, 0 for a single pass
+    float checkpoint_interval;//Seconds between checkpoints written next to the output image, 0 for none
 
     void SetCamera(const Camera &c);
 
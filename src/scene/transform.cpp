@@ -21,6 +21,11 @@ void Transform::SetMatrices()
             * glm::scale(glm::mat4(1.0f), scale);
     inverse_worldTransform = glm::inverse(worldTransform);
     inverse_transpose_worldTransform = glm::inverse(glm::transpose(worldTransform));
+
+    affine_worldTransform = glm::mat4x3(worldTransform);
+    affine_inverse_worldTransform = glm::mat4x3(inverse_worldTransform);
+    normal_worldTransform = glm::mat3(inverse_transpose_worldTransform);
+    is_identity = (worldTransform == glm::mat4(1.0f));
 }
 
 const glm::mat4& Transform::T()
@@ -17,6 +17,17 @@ public:
 
     const glm::vec3 &getScale();
 
+    //Affine (3x4) copies of T and invT plus the 3x3 normal matrix, precomputed in SetMatrices.
+    //The bottom row of an affine mat4 is always (0,0,0,1), so these skip a quarter of the multiplies.
+    const glm::mat4x3 &affineT() const {return affine_worldTransform;}
+    const glm::mat4x3 &affineInvT() const {return affine_inverse_worldTransform;}
+
+    inline glm::vec3 TransformPoint(const glm::vec3 &p) const {return affine_worldTransform * glm::vec4(p, 1.0f);}
+    inline glm::vec3 TransformNormal(const glm::vec3 &n) const {return normal_worldTransform * n;}
+
+    //True when T is the identity, e.g. for the triangles of a Mesh which live in their Mesh's object space
+    inline bool IsIdentity() const {return is_identity;}
+
 private:
     glm::vec3 translation;
     glm::vec3 rotation;
@@ -25,4 +36,9 @@ private:
     glm::mat4 worldTransform;
     glm::mat4 inverse_worldTransform;
     glm::mat4 inverse_transpose_worldTransform;
+
+    glm::mat4x3 affine_worldTransform;
+    glm::mat4x3 affine_inverse_worldTransform;
+    glm::mat3 normal_worldTransform;
+    bool is_identity;
 };
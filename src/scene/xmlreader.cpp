@@ -13,6 +13,12 @@
 #include <raytracing/samplers/uniformpixelsampler.h>
 #include <raytracing/samplers/stratifiedpixelsampler.h>
 #include <raytracing/bidirectionalintegrator.h>
+#include <raytracing/vcmintegrator.h>
+#include <raytracing/sppmintegrator.h>
+#include <raytracing/wavefrontintegrator.h>
+#include <raytracing/samplers/sobolsampler.h>
+#include <raytracing/samplers/haltonsampler.h>
+#include <raytracing/samplers/independentsampler.h>
 
 #include <scene/materials/bxdfs/lambertBxDF.h>
 #include <scene/materials/bxdfs/specularreflectionbxdf.h>
@@ -78,11 +84,39 @@ void XMLReader::LoadSceneFromFile(QFile &file, const QStringRef &local_path, Sce
                 {
                     scene.sqrt_samples = LoadPixelSamples(xml_reader);
                 }
+                else if(QString::compare(tag, QString("aovs")) == 0)
+                {
+                    //<aovs>true</aovs> stores albedo, normal, depth, IDs and the direct/indirect split with the image
+                    xml_reader.readNext();
+                    if(xml_reader.isCharacters())
+                    {
+                        scene.film.EnableAOVs(QStringRef::compare(xml_reader.text(), QString("true")) == 0
+                                              || QStringRef::compare(xml_reader.text(), QString("1")) == 0);
+                    }
+                    xml_reader.readNext();
+                }
+                else if(QString::compare(tag, QString("denoise")) == 0)
+                {
+                    //The denoiser is guided by the AOVs, so asking for it turns them on
+                    delete scene.denoiser;
+                    scene.denoiser = LoadDenoiser(xml_reader);
+                    scene.film.EnableAOVs(true);
+                }
+                else if(QString::compare(tag, QString("filter")) == 0)
+                {
+                    delete scene.filter;
+                    scene.filter = LoadFilter(xml_reader);
+                }
+                else if(QString::compare(tag, QString("checkpoint")) == 0)
+                {
+                    LoadCheckpoint(xml_reader, scene);
+                }
             }
         }
         //Associate the materials in the XML file with the geometries that use those materials.
         for(int i = 0; i < scene.materials.size(); i++)
         {
+            scene.materials[i]->id = i;
             QList<Geometry*> l = material_to_geometry_map.value(scene.materials[i]->name);
             for(int j = 0; j < l.size(); j++)
             {
@@ -101,8 +135,10 @@ void XMLReader::LoadSceneFromFile(QFile &file, const QStringRef &local_path, Sce
 
         //Copy emissive geometry from the list of objects to the list of lights
         QList<Geometry*> to_lights;
-        for(Geometry *g : scene.objects)
+        for(int i = 0; i < scene.objects.size(); i++)
         {
+            Geometry *g = scene.objects[i];
+            g->id = i;
             g->create();
             if(g->material->is_light_source)
             {
@@ -114,6 +150,7 @@ void XMLReader::LoadSceneFromFile(QFile &file, const QStringRef &local_path, Sce
         {
             scene.lights.append(g);
         }
+        scene.light_sampler.Build(scene.lights);
         file.close();
     }
 }
@@ -464,10 +501,22 @@ Integrator* XMLReader::LoadIntegrator(QXmlStreamReader &xml_reader)
     {
         result = new Integrator();
     }
+    else if(QStringRef::compare(type, QString("wavefront")) == 0) // indirectLighting traced breadth-first
+    {
+        result = new WavefrontIntegrator();
+    }
     else if(QStringRef::compare(type, QString("bidirectionalIntegrator")) == 0)
     {
         result = new BidirectionalIntegrator();
     }
+    else if(QStringRef::compare(type, QString("vcm")) == 0)
+    {
+        result = new VCMIntegrator();
+    }
+    else if(QStringRef::compare(type, QString("sppm")) == 0)
+    {
+        result = new SPPMIntegrator();
+    }
 
     int LightNumber = 1;
     int BRDFNumber = 1;
@@ -502,6 +551,134 @@ Integrator* XMLReader::LoadIntegrator(QXmlStreamReader &xml_reader)
             }
             xml_reader.readNext();
         }
+        else if(QString::compare(tag, QString("sampler")) == 0)
+        {
+            xml_reader.readNext();
+            if(xml_reader.isCharacters())
+            {
+                if(QStringRef::compare(xml_reader.text(), QString("halton")) == 0)
+                    result->SetSampler(new HaltonSampler());
+                else if(QStringRef::compare(xml_reader.text(), QString("independent")) == 0)
+                    result->SetSampler(new IndependentSampler());
+                else
+                    result->SetSampler(new SobolSampler());
+            }
+            xml_reader.readNext();
+        }
+        //Russian roulette: bounces before it starts, and the clamp on the survival probability
+        else if(QString::compare(tag, QString("rrDepth")) == 0)
+        {
+            xml_reader.readNext();
+            if(xml_reader.isCharacters())
+            {
+                result->SetRussianRoulette(xml_reader.text().toInt(), result->rr_min_survival, result->rr_max_survival);
+            }
+            xml_reader.readNext();
+        }
+        else if(QString::compare(tag, QString("rrMinSurvival")) == 0)
+        {
+            xml_reader.readNext();
+            if(xml_reader.isCharacters())
+            {
+                result->SetRussianRoulette(result->rr_depth, xml_reader.text().toFloat(), result->rr_max_survival);
+            }
+            xml_reader.readNext();
+        }
+        else if(QString::compare(tag, QString("rrMaxSurvival")) == 0)
+        {
+            xml_reader.readNext();
+            if(xml_reader.isCharacters())
+            {
+                result->SetRussianRoulette(result->rr_depth, result->rr_min_survival, xml_reader.text().toFloat());
+            }
+            xml_reader.readNext();
+        }
+        else if(QString::compare(tag, QString("queueSize")) == 0)
+        {
+            xml_reader.readNext();
+            WavefrontIntegrator* wavefront = dynamic_cast<WavefrontIntegrator*>(result);
+            if(xml_reader.isCharacters() && wavefront != NULL)
+            {
+                wavefront->SetQueueSize(xml_reader.text().toInt());
+            }
+            xml_reader.readNext();
+        }
+        //VCM and SPPM settings; other integrators ignore them
+        else if(QString::compare(tag, QString("mergeRadius")) == 0)
+        {
+            xml_reader.readNext();
+            VCMIntegrator* vcm = dynamic_cast<VCMIntegrator*>(result);
+            if(xml_reader.isCharacters() && vcm != NULL)
+            {
+                vcm->SetMergeRadius(xml_reader.text().toFloat());
+            }
+            xml_reader.readNext();
+        }
+        else if(QString::compare(tag, QString("radiusAlpha")) == 0)
+        {
+            xml_reader.readNext();
+            VCMIntegrator* vcm = dynamic_cast<VCMIntegrator*>(result);
+            SPPMIntegrator* sppm = dynamic_cast<SPPMIntegrator*>(result);
+            if(xml_reader.isCharacters() && vcm != NULL)
+            {
+                vcm->SetRadiusAlpha(xml_reader.text().toFloat());
+            }
+            if(xml_reader.isCharacters() && sppm != NULL)
+            {
+                sppm->SetRadiusAlpha(xml_reader.text().toFloat());
+            }
+            xml_reader.readNext();
+        }
+        else if(QString::compare(tag, QString("lightPathCount")) == 0)
+        {
+            xml_reader.readNext();
+            VCMIntegrator* vcm = dynamic_cast<VCMIntegrator*>(result);
+            if(xml_reader.isCharacters() && vcm != NULL)
+            {
+                vcm->SetLightPathCount(xml_reader.text().toInt());
+            }
+            xml_reader.readNext();
+        }
+        else if(QString::compare(tag, QString("photonRadius")) == 0)
+        {
+            xml_reader.readNext();
+            SPPMIntegrator* sppm = dynamic_cast<SPPMIntegrator*>(result);
+            if(xml_reader.isCharacters() && sppm != NULL)
+            {
+                sppm->SetPhotonRadius(xml_reader.text().toFloat());
+            }
+            xml_reader.readNext();
+        }
+        else if(QString::compare(tag, QString("photonPathCount")) == 0)
+        {
+            xml_reader.readNext();
+            SPPMIntegrator* sppm = dynamic_cast<SPPMIntegrator*>(result);
+            if(xml_reader.isCharacters() && sppm != NULL)
+            {
+                sppm->SetPhotonPathCount(xml_reader.text().toInt());
+            }
+            xml_reader.readNext();
+        }
+        else if(QString::compare(tag, QString("maxPhotons")) == 0)
+        {
+            xml_reader.readNext();
+            SPPMIntegrator* sppm = dynamic_cast<SPPMIntegrator*>(result);
+            if(xml_reader.isCharacters() && sppm != NULL)
+            {
+                sppm->SetMaxPhotons(xml_reader.text().toInt());
+            }
+            xml_reader.readNext();
+        }
+        else if(QString::compare(tag, QString("samplesPerPass")) == 0)
+        {
+            xml_reader.readNext();
+            SPPMIntegrator* sppm = dynamic_cast<SPPMIntegrator*>(result);
+            if(xml_reader.isCharacters() && sppm != NULL)
+            {
+                sppm->SetSamplesPerPass(xml_reader.text().toInt());
+            }
+            xml_reader.readNext();
+        }
     }
     result->Number_Light = LightNumber;
     result->Number_BRDF = BRDFNumber;
@@ -522,6 +699,71 @@ unsigned int XMLReader::LoadPixelSamples(QXmlStreamReader &xml_reader)
     }
 }
 
+Filter* XMLReader::LoadFilter(QXmlStreamReader &xml_reader)
+{
+    //<filter type="gaussian|mitchell|blackmanharris|box" radius="..."/>, plus alpha for gaussian and B, C for mitchell
+    QXmlStreamAttributes attribs(xml_reader.attributes());
+    QStringRef type = attribs.value(QString(), QString("type"));
+    QStringRef radius_attrib = attribs.value(QString(), QString("radius"));
+    QStringRef alpha = attribs.value(QString(), QString("alpha"));
+    QStringRef B = attribs.value(QString(), QString("B"));
+    QStringRef C = attribs.value(QString(), QString("C"));
+    float radius = QStringRef::compare(radius_attrib, QString("")) != 0 ? radius_attrib.toFloat() : 2.0f;
+
+    if(QStringRef::compare(type, QString("gaussian")) == 0)
+    {
+        return new GaussianFilter(radius, QStringRef::compare(alpha, QString("")) != 0 ? alpha.toFloat() : 2.0f);
+    }
+    else if(QStringRef::compare(type, QString("mitchell")) == 0)
+    {
+        return new MitchellFilter(radius,
+                                  QStringRef::compare(B, QString("")) != 0 ? B.toFloat() : 1.0f / 3.0f,
+                                  QStringRef::compare(C, QString("")) != 0 ? C.toFloat() : 1.0f / 3.0f);
+    }
+    else if(QStringRef::compare(type, QString("blackmanharris")) == 0)
+    {
+        return new BlackmanHarrisFilter(radius);
+    }
+    //"box" keeps the per-pixel average
+    return NULL;
+}
+
+Denoiser* XMLReader::LoadDenoiser(QXmlStreamReader &xml_reader)
+{
+    //<denoise iterations="4" sigmaColor="4" sigmaNormal="64" sigmaDepth="0.1" sigmaAlbedo="0.1" threads="0"/>, all optional
+    QXmlStreamAttributes attribs(xml_reader.attributes());
+    Denoiser* result = new Denoiser();
+    QStringRef value = attribs.value(QString(), QString("iterations"));
+    if(QStringRef::compare(value, QString("")) != 0)
+        result->iterations = value.toInt();
+    value = attribs.value(QString(), QString("sigmaColor"));
+    if(QStringRef::compare(value, QString("")) != 0)
+        result->sigma_color = value.toFloat();
+    value = attribs.value(QString(), QString("sigmaNormal"));
+    if(QStringRef::compare(value, QString("")) != 0)
+        result->sigma_normal = value.toFloat();
+    value = attribs.value(QString(), QString("sigmaDepth"));
+    if(QStringRef::compare(value, QString("")) != 0)
+        result->sigma_depth = value.toFloat();
+    value = attribs.value(QString(), QString("sigmaAlbedo"));
+    if(QStringRef::compare(value, QString("")) != 0)
+        result->sigma_albedo = value.toFloat();
+    value = attribs.value(QString(), QString("threads"));
+    if(QStringRef::compare(value, QString("")) != 0)
+        result->thread_count = value.toInt();
+    return result;
+}
+
+void XMLReader::LoadCheckpoint(QXmlStreamReader &xml_reader, Scene &scene)
+{
+    //<checkpoint interval="300" passSamples="4"/>: seconds between checkpoints and camera samples per pixel in each pass.
+    //Checkpoints are only written between passes, so a render that checkpoints is split into passes of 4 by default.
+    QXmlStreamAttributes attribs(xml_reader.attributes());
+    QStringRef interval = attribs.value(QString(), QString("interval"));
+    QStringRef pass_samples = attribs.value(QString(), QString("passSamples"));
+    scene.checkpoint_interval = QStringRef::compare(interval, QString("")) != 0 ? interval.toFloat() : 300.0f;
+    scene.pass_samples = QStringRef::compare(pass_samples, QString("")) != 0 ? pass_samples.toInt() : 4;
+}
 
 QImage* XMLReader::LoadTextureFile(QXmlStreamReader &xml_reader, const QStringRef &local_path)
 {
@@ -7,6 +7,8 @@
 #include <raytracing/samplers/pixelsampler.h>
 #include <scene/geometry/geometry.h>
 #include <raytracing/integrator.h>
+#include <raytracing/filters/filter.h>
+#include <raytracing/denoiser.h>
 
 class XMLReader
 {
@@ -18,6 +20,9 @@ public:
     Transform LoadTransform(QXmlStreamReader &xml_reader);
     Integrator* LoadIntegrator(QXmlStreamReader &xml_reader);
     unsigned int LoadPixelSamples(QXmlStreamReader &xml_reader);
+    Filter* LoadFilter(QXmlStreamReader &xml_reader);
+    Denoiser* LoadDenoiser(QXmlStreamReader &xml_reader);
+    void LoadCheckpoint(QXmlStreamReader &xml_reader, Scene &scene);
     QImage* LoadTextureFile(QXmlStreamReader &xml_reader, const QStringRef &local_path);
     BxDF* LoadBxDF(QXmlStreamReader &xml_reader);
     glm::vec3 ToVec3(const QStringRef &s);
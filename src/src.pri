@@ -41,7 +41,22 @@ SOURCES += \
     $$PWD/scene/materials/bxdfs/transmissionbxdf.cpp \
     $$PWD/scene/materials/bxdfs/anisotropicbxdf.cpp \
     $$PWD/raytracing/bidirectionalintegrator.cpp \
-    $$PWD/scene/geometry/bbox.cpp
+    $$PWD/scene/geometry/bbox.cpp \
+    $$PWD/raytracing/lightsampler.cpp \
+    $$PWD/raytracing/hashgrid.cpp \
+    $$PWD/raytracing/vcmintegrator.cpp \
+    $$PWD/raytracing/sppmintegrator.cpp \
+    $$PWD/raytracing/wavefrontintegrator.cpp \
+    $$PWD/raytracing/samplers/sampler.cpp \
+    $$PWD/raytracing/samplers/independentsampler.cpp \
+    $$PWD/raytracing/samplers/sobolsampler.cpp \
+    $$PWD/raytracing/samplers/haltonsampler.cpp \
+    $$PWD/raytracing/filters/filter.cpp \
+    $$PWD/raytracing/hdrwriter.cpp \
+    $$PWD/raytracing/denoiser.cpp \
+    $$PWD/headlessrender.cpp \
+    $$PWD/openGL/progressivedisplay.cpp \
+    $$PWD/tilequeue.cpp
 
 HEADERS += \
     $$PWD/mainwindow.h \
@@ -88,4 +103,21 @@ HEADERS += \
     $$PWD/scene/materials/bxdfs/transmissionbxdf.h \
     $$PWD/scene/materials/bxdfs/anisotropicbxdf.h \
     $$PWD/raytracing/bidirectionalintegrator.h \
-    $$PWD/scene/geometry/bbox.h
+    $$PWD/scene/geometry/bbox.h \
+    $$PWD/raytracing/frame.h \
+    $$PWD/raytracing/lightsampler.h \
+    $$PWD/raytracing/hashgrid.h \
+    $$PWD/raytracing/vcmintegrator.h \
+    $$PWD/raytracing/sppmintegrator.h \
+    $$PWD/raytracing/wavefrontintegrator.h \
+    $$PWD/scene/materials/bxdfs/bxdfsimd.h \
+    $$PWD/raytracing/samplers/sampler.h \
+    $$PWD/raytracing/samplers/independentsampler.h \
+    $$PWD/raytracing/samplers/sobolsampler.h \
+    $$PWD/raytracing/samplers/haltonsampler.h \
+    $$PWD/raytracing/filters/filter.h \
+    $$PWD/raytracing/hdrwriter.h \
+    $$PWD/raytracing/denoiser.h \
+    $$PWD/headlessrender.h \
+    $$PWD/openGL/progressivedisplay.h \
+    $$PWD/tilequeue.h
@@ -0,0 +1,55 @@
+#include <tilequeue.h>
+#include <algorithm>
+
+TileQueue::TileQueue() : head(NULL)
+{}
+
+TileQueue::~TileQueue()
+{
+    Drain();
+}
+
+void TileQueue::PushDirty(const QRect &r)
+{
+    Event* e = new Event();
+    e->rect = r;
+    e->finished = false;
+    Push(e);
+}
+
+void TileQueue::PushFinished()
+{
+    Event* e = new Event();
+    e->finished = true;
+    Push(e);
+}
+
+void TileQueue::Push(Event* e)
+{
+    Event* old = head.load(std::memory_order_relaxed);
+    do
+    {
+        e->next = old;
+    }
+    while(!head.compare_exchange_weak(old, e, std::memory_order_release, std::memory_order_relaxed));
+    //Whoever finds the stack empty tells the GUI; later pushes ride along with that drain
+    if(old == NULL)
+        emit Ready();
+}
+
+QList<TileQueue::Event> TileQueue::Drain()
+{
+    //Taking the whole stack at once means nodes are never popped one by one, so there is no ABA problem
+    Event* e = head.exchange(NULL, std::memory_order_acquire);
+    QList<Event> events;
+    while(e != NULL)
+    {
+        events.append(*e);
+        Event* next = e->next;
+        delete e;
+        e = next;
+    }
+    //The stack hands them back newest first
+    std::reverse(events.begin(), events.end());
+    return events;
+}
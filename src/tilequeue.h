@@ -0,0 +1,36 @@
+#pragma once
+#include <QObject>
+#include <QRect>
+#include <QList>
+#include <atomic>
+
+//Render threads report progress to the GUI through this queue: which rows of the film they redrew, and when they're done.
+//It's a lock-free stack any thread can push to, emptied all at once by the GUI thread. Only the push that finds it
+//empty emits Ready, and Ready is connected with a queued connection, so the GUI gets one event per batch of reports
+//however many threads are rendering.
+class TileQueue : public QObject
+{
+    Q_OBJECT
+public:
+    struct Event
+    {
+        QRect rect;//Redrawn pixels, empty for a thread that finished
+        bool finished;
+        Event* next;
+    };
+
+    TileQueue();
+    ~TileQueue();
+
+    void PushDirty(const QRect &r);
+    void PushFinished();
+    //Everything pushed since the last call, oldest first
+    QList<Event> Drain();
+
+signals:
+    void Ready();
+
+private:
+    void Push(Event* e);
+    std::atomic<Event*> head;
+};